@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "arena.h"
+
+/**
+* Creates an empty arena
+* @param block_size size of each block taken from the heap
+*/
+Arena::Arena(size_t block_size)
+    : block_size(block_size), current(nullptr), remaining(0), reserved(0), allocated(0) {}
+
+Arena::~Arena() {
+  for (void* block : blocks) {
+    free(block);
+  }
+}
+
+void* Arena::AllocateBlock(size_t bytes) {
+  void* block = malloc(bytes);
+  if (block == nullptr) throw std::bad_alloc();
+  blocks.push_back(block);
+  reserved += bytes;
+  return block;
+}
+
+/**
+* Takes memory from the current block, starting a new block if it does not fit
+* @param bytes size of the allocation
+* @param alignment required alignment, at most alignof(std::max_align_t)
+* @return the allocated memory
+*/
+void* Arena::Allocate(size_t bytes, size_t alignment) {
+  allocated += bytes;
+  // Large arrays get a block of their own, so they don't waste the rest of the current block
+  if (bytes > block_size / 4) {
+    return AllocateBlock(bytes);
+  }
+  size_t padding = (alignment - reinterpret_cast<uintptr_t>(current) % alignment) % alignment;
+  if (current == nullptr || padding + bytes > remaining) {
+    current = static_cast<char*>(AllocateBlock(block_size));
+    remaining = block_size;
+    padding = 0;
+  }
+  void* result = current + padding;
+  current += padding + bytes;
+  remaining -= padding + bytes;
+  return result;
+}
+
+size_t Arena::BytesReserved() const {
+  return reserved;
+}
+
+size_t Arena::BytesAllocated() const {
+  return allocated;
+}
+
+size_t Arena::NumBlocks() const {
+  return blocks.size();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Monotonic allocator: hands out memory from a few large blocks and frees all of it at once when destroyed. Freeing
+// a single allocation does nothing. Not thread-safe, threads that build data at the same time need separate arenas
+class Arena {
+  public:
+    explicit Arena(size_t block_size = 1 << 20);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    void* Allocate(size_t bytes, size_t alignment);
+    // Bytes held in blocks, including space not handed out yet
+    size_t BytesReserved() const;
+    // Bytes handed out by Allocate
+    size_t BytesAllocated() const;
+    size_t NumBlocks() const;
+  private:
+    void* AllocateBlock(size_t bytes);
+    std::vector<void*> blocks;
+    size_t block_size;
+    char* current;
+    size_t remaining;
+    size_t reserved;
+    size_t allocated;
+};
+
+// Standard allocator that takes memory from a shared Arena, or from the heap when it has no arena. Containers keep
+// their arena alive, so the arena is freed in one shot when the last container using it is destroyed. Copies of a
+// container are allocated on the heap, so a copy never keeps the original's arena alive
+template <typename T>
+class ArenaAllocator {
+  public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(std::shared_ptr<Arena> arena) : arena(std::move(arena)) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.GetArena()) {}
+
+    T* allocate(size_t n) {
+      if (!arena) return static_cast<T*>(::operator new(n * sizeof(T)));
+      return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t) {
+      if (!arena) ::operator delete(p);
+    }
+    ArenaAllocator select_on_container_copy_construction() const {
+      return ArenaAllocator();
+    }
+    const std::shared_ptr<Arena>& GetArena() const {
+      return arena;
+    }
+  private:
+    std::shared_ptr<Arena> arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second) {
+  return first.GetArena() == second.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second) {
+  return !(first == second);
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "graph.h"
+
+namespace {
+
+// Disjoint sets of vertex ids with union by size and path halving
+class UnionFind {
+  public:
+    explicit UnionFind(uint32_t n) : parent(n), size(n, 1) {
+      for (uint32_t i = 0; i < n; i++) {
+        parent[i] = i;
+      }
+    }
+    uint32_t Find(uint32_t x) {
+      while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+      }
+      return x;
+    }
+    void Union(uint32_t a, uint32_t b) {
+      a = Find(a);
+      b = Find(b);
+      if (a == b) return;
+      if (size[a] < size[b]) std::swap(a, b);
+      parent[b] = a;
+      size[a] += size[b];
+    }
+  private:
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> size;
+};
+
+}  // namespace
+
+/**
+* Finds the strongly connected components with an iterative version of Tarjan's algorithm
+* @return the component of every vertex and the size of every component
+*/
+Components Graph::StronglyConnectedComponents() const {
+  const uint32_t kUnvisited = UINT32_MAX;
+  uint32_t n = vertices.size();
+  Components result;
+  result.component.assign(n, kInvalidId);
+  // Discovery order of each vertex, and the lowest discovery order reachable from its subtree through the stack
+  std::vector<uint32_t> index(n, kUnvisited);
+  std::vector<uint32_t> low(n);
+  std::vector<bool> on_stack(n);
+  std::vector<uint32_t> stack;
+  // Depth-first search frames: a vertex and the position of the next outgoing edge to follow
+  std::vector<std::pair<uint32_t, uint32_t>> frames;
+  uint32_t counter = 0;
+
+  for (uint32_t root = 0; root < n; root++) {
+    if (index[root] != kUnvisited) continue;
+    index[root] = low[root] = counter++;
+    stack.push_back(root);
+    on_stack[root] = true;
+    frames.emplace_back(root, offsets[root]);
+    while (!frames.empty()) {
+      uint32_t v = frames.back().first;
+      uint32_t& edge = frames.back().second;
+      if (edge < offsets[v + 1]) {
+        uint32_t w = arcs[edge++].target;
+        if (index[w] == kUnvisited) {
+          index[w] = low[w] = counter++;
+          stack.push_back(w);
+          on_stack[w] = true;
+          // edge is not used after this, push_back may move the frames
+          frames.emplace_back(w, offsets[w]);
+        } else if (on_stack[w]) {
+          low[v] = std::min(low[v], index[w]);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        uint32_t parent = frames.back().first;
+        low[parent] = std::min(low[parent], low[v]);
+      }
+      // v is the root of a component made of the vertices above it on the stack
+      if (low[v] != index[v]) continue;
+      uint32_t id = result.sizes.size();
+      uint32_t size = 0;
+      uint32_t w;
+      do {
+        w = stack.back();
+        stack.pop_back();
+        on_stack[w] = false;
+        result.component[w] = id;
+        size++;
+      } while (w != v);
+      result.sizes.push_back(size);
+    }
+  }
+  return result;
+}
+
+/**
+* Finds the weakly connected components by merging the endpoints of every edge in a union-find structure
+* @return the component of every vertex and the size of every component
+*/
+Components Graph::WeaklyConnectedComponents() const {
+  uint32_t n = vertices.size();
+  UnionFind sets(n);
+  for (uint32_t u = 0; u < n; u++) {
+    for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+      sets.Union(u, arcs[edge].target);
+    }
+  }
+  Components result;
+  result.component.assign(n, kInvalidId);
+  // Roots are numbered as they are first seen, so components are ordered by their lowest vertex id
+  std::vector<uint32_t> number(n, kInvalidId);
+  for (uint32_t u = 0; u < n; u++) {
+    uint32_t root = sets.Find(u);
+    if (number[root] == kInvalidId) {
+      number[root] = result.sizes.size();
+      result.sizes.push_back(0);
+    }
+    result.component[u] = number[root];
+    result.sizes[number[root]]++;
+  }
+  return result;
+}
+
+/**
+* Breadth-first search that stays inside one component
+* @param start id of the start vertex, in the component
+* @param backward whether to follow edges backwards, giving the distance from each vertex to start
+* @param component component of every vertex id
+* @param id the component to search
+* @param levels receives the level of every vertex of the component
+* @return the largest level, the eccentricity of start if the component is strongly connected
+*/
+uint32_t Graph::ComponentBFS(uint32_t start, bool backward, const std::vector<uint32_t>& component, uint32_t id,
+                             std::vector<uint32_t>& levels) const {
+  // Shortest routes between two airports of a strongly connected component never leave it, so the other vertices are
+  // skipped. Visited marks are the levels themselves, reset for the component first
+  for (uint32_t v = 0; v < vertices.size(); v++) {
+    if (component[v] == id) levels[v] = BFSTree::kUnreached;
+  }
+  std::vector<uint32_t> queue = {start};
+  levels[start] = 0;
+  for (size_t i = 0; i < queue.size(); i++) {
+    uint32_t u = queue[i];
+    auto visit = [&](uint32_t v) {
+      if (component[v] != id || levels[v] != BFSTree::kUnreached) return;
+      levels[v] = levels[u] + 1;
+      queue.push_back(v);
+    };
+    if (backward) {
+      ForEachSource(u, visit);
+    } else {
+      ForEachTarget(u, visit);
+    }
+  }
+  return levels[queue.back()];
+}
+
+/**
+* Computes the diameter of the largest strongly connected component with diFUB (Crescenzi et al., "On computing the
+* diameter of real-world directed (weighted) graphs", 2012), and bounds every eccentricity from sampled searches
+* @param samples number of airports to run a forward and a backward search from
+* @param threads number of threads running the sampled searches
+* @return the diameter, radius bounds, eccentricity bounds and number of searches run
+*/
+EccentricityStats Graph::Eccentricities(unsigned samples, unsigned threads) const {
+  uint32_t n = vertices.size();
+  EccentricityStats stats = {0, 0, 0, 0, {}, {}, 0, 0};
+  // An empty graph has no components to measure
+  if (n == 0) return stats;
+  Components strong = StronglyConnectedComponents();
+  stats.component = std::max_element(strong.sizes.begin(), strong.sizes.end()) - strong.sizes.begin();
+  stats.eccentricity_lower.assign(n, BFSTree::kUnreached);
+  stats.eccentricity_upper.assign(n, BFSTree::kUnreached);
+  const std::vector<uint32_t>& component = strong.component;
+  std::vector<uint32_t> members;
+  for (uint32_t v = 0; v < n; v++) {
+    if (component[v] != stats.component) continue;
+    members.push_back(v);
+    stats.eccentricity_lower[v] = 0;
+    stats.eccentricity_upper[v] = n;
+  }
+  auto degree = [this](uint32_t u) {
+    return (offsets[u + 1] - offsets[u]) + (in_offsets[u + 1] - in_offsets[u]);
+  };
+  // Best-connected airports first: hubs are central, so their searches have few levels and give tight upper bounds
+  std::stable_sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+    return degree(a) > degree(b);
+  });
+
+  // diFUB: with forward levels F_i and backward levels B_i from a central vertex u, any route longer than 2(i - 1)
+  // starts in some B_j or ends in some F_j with j >= i. The fringes are searched from the outermost level inwards
+  // (backward searches from F_i, forward searches from B_i). Once every level above i has been searched, no route
+  // longer than 2i is left unmeasured, so the search stops before level i when the lower bound reaches 2i
+  uint32_t u = members.front();
+  std::vector<uint32_t> forward(n), backward(n), levels(n);
+  uint32_t forward_eccentricity = ComponentBFS(u, false, component, stats.component, forward);
+  uint32_t backward_eccentricity = ComponentBFS(u, true, component, stats.component, backward);
+  stats.diameter_bfs_runs = 2;
+  uint32_t lower = std::max(forward_eccentricity, backward_eccentricity);
+  // Double sweep: the airport farthest from u is likely to be at one end of a longest route
+  uint32_t farthest = *std::max_element(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+    return backward[a] < backward[b];
+  });
+  lower = std::max(lower, ComponentBFS(farthest, false, component, stats.component, levels));
+  stats.diameter_bfs_runs++;
+  std::vector<std::vector<uint32_t>> forward_fringe(forward_eccentricity + 1), backward_fringe(backward_eccentricity + 1);
+  for (uint32_t v : members) {
+    forward_fringe[forward[v]].push_back(v);
+    backward_fringe[backward[v]].push_back(v);
+  }
+  for (uint32_t i = std::max(forward_eccentricity, backward_eccentricity); i > 0 && lower < 2 * i; i--) {
+    if (i < forward_fringe.size()) {
+      for (uint32_t v : forward_fringe[i]) {
+        lower = std::max(lower, ComponentBFS(v, true, component, stats.component, levels));
+        stats.diameter_bfs_runs++;
+      }
+    }
+    if (i < backward_fringe.size()) {
+      for (uint32_t v : backward_fringe[i]) {
+        lower = std::max(lower, ComponentBFS(v, false, component, stats.component, levels));
+        stats.diameter_bfs_runs++;
+      }
+    }
+  }
+  stats.diameter = lower;
+
+  // Sampled bounds. A forward search from s and a backward one give d(s, .) and d(., s), and for every v:
+  // ecc(v) >= d(v, s), ecc(v) >= ecc(s) - d(s, v) and ecc(v) <= d(v, s) + ecc(s)
+  std::vector<uint32_t> sample_vertices;
+  samples = std::min<size_t>(samples, members.size());
+  // Half of the samples are hubs for the upper bounds, the rest are spread at random for the lower bounds
+  std::vector<uint32_t> others(members.begin() + samples / 2, members.end());
+  std::shuffle(others.begin(), others.end(), std::mt19937(1));
+  sample_vertices.assign(members.begin(), members.begin() + samples / 2);
+  sample_vertices.insert(sample_vertices.end(), others.begin(), others.begin() + (samples - samples / 2));
+  if (threads == 0) threads = 1;
+  std::vector<std::vector<uint32_t>> lower_bounds(threads, stats.eccentricity_lower);
+  std::vector<std::vector<uint32_t>> upper_bounds(threads, stats.eccentricity_upper);
+  std::atomic<size_t> next_sample(0);
+  auto run_samples = [&](unsigned worker) {
+    std::vector<uint32_t> from(n), to(n);
+    std::vector<uint32_t>& lows = lower_bounds[worker];
+    std::vector<uint32_t>& highs = upper_bounds[worker];
+    for (size_t i = next_sample++; i < sample_vertices.size(); i = next_sample++) {
+      uint32_t s = sample_vertices[i];
+      uint32_t eccentricity = ComponentBFS(s, false, component, stats.component, from);
+      ComponentBFS(s, true, component, stats.component, to);
+      for (uint32_t v : members) {
+        lows[v] = std::max({lows[v], to[v], eccentricity > from[v] ? eccentricity - from[v] : 0});
+        highs[v] = std::min(highs[v], to[v] + eccentricity);
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned worker = 1; worker < threads; worker++) {
+    workers.emplace_back(run_samples, worker);
+  }
+  run_samples(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  stats.sample_bfs_runs = 2 * sample_vertices.size();
+  for (uint32_t v : members) {
+    for (unsigned worker = 0; worker < threads; worker++) {
+      stats.eccentricity_lower[v] = std::max(stats.eccentricity_lower[v], lower_bounds[worker][v]);
+      stats.eccentricity_upper[v] = std::min(stats.eccentricity_upper[v], upper_bounds[worker][v]);
+    }
+    // Every eccentricity is at most the diameter
+    stats.eccentricity_upper[v] = std::min(stats.eccentricity_upper[v], stats.diameter);
+  }
+  // The forward search from u gave its eccentricity exactly
+  stats.eccentricity_lower[u] = stats.eccentricity_upper[u] = forward_eccentricity;
+  stats.radius_lower = n;
+  stats.radius_upper = n;
+  for (uint32_t v : members) {
+    stats.radius_lower = std::min(stats.radius_lower, stats.eccentricity_lower[v]);
+    stats.radius_upper = std::min(stats.radius_upper, stats.eccentricity_upper[v]);
+  }
+  return stats;
+}
@@ -1,10 +1,11 @@
-#include <sstream>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <queue>
 #include <limits>
 #include <algorithm>
+#include <thread>
+#include <cstring>
 
 #include "graph.h"
 
@@ -18,43 +19,96 @@ Vertex::Vertex() {}
 * @param csv the line of a file representing a vertex
 */
 Vertex::Vertex(const std::string& csv) {
-  // https://www.tutorialspoint.com/parsing-a-comma-delimited-std-string-in-cplusplus
-  std::vector<std::string> parsed;
-  std::stringstream ss(csv);
-  while (ss.good()) {
-    std::string substring;
-    std::getline(ss, substring, ',');
-    parsed.push_back(substring);
-  }
-  // stod exception caused by extra commas (usually in airport name), disregard these airports for now
-  coords.first = std::stod(parsed[6]);
-  coords.second = std::stod(parsed[7]);
-  key = parsed[4];
-  // Key should be 5 characters (three character airport code and quotation marks)
-  if (key.length() != 5) {
-    throw std::invalid_argument("Invalid key");
-  }
-  // Remove quotation marks
-  key = key.substr(1, 3);
-  name = parsed[1];
+  if (!Parse(csv, *this)) {
+    throw std::invalid_argument("Invalid airport");
+  }
+}
+
+namespace {
+
+// The fields of a valid airport line, pointing into the line with quotation marks removed
+struct AirportFields {
+  std::string_view key;
+  std::string_view name;
+  std::string_view city;
+  std::string_view country;
+  Coord coords;
+};
+
+/**
+* Validates one line of the airport dataset and extracts the fields a vertex keeps, without copying them
+* @param csv the line of a file representing a vertex
+* @param out the fields of the airport
+* @return whether the line was a valid airport
+*/
+bool ParseAirport(std::string_view csv, AirportFields& out) {
+  // Only the first 8 fields (up to longitude) are used
+  std::string_view parsed[8];
+  if (SplitFields(csv, parsed, 8) < 8) {
+    return false;
+  }
+  // Parse failures are caused by extra commas (usually in airport name), disregard these airports for now
+  if (!ParseDouble(parsed[6], out.coords.first) || !ParseDouble(parsed[7], out.coords.second)) {
+    return false;
+  }
+  // Key should be 5 characters (three letter or digit airport code and quotation marks)
+  if (parsed[4].length() != 5 || !PackedCode(parsed[4].substr(1, 3)).IsValid()) {
+    return false;
+  }
   // Name, city, country must all be at lease 3 characters with quotation marks
-  if (name.length() < 3 || parsed[2].length() < 3 || parsed[3].length() < 3) {
-    throw std::invalid_argument("Invalid city or name");
+  if (parsed[1].length() < 3 || parsed[2].length() < 3 || parsed[3].length() < 3) {
+    return false;
   }
-  // Removing quotation marks and formating location as City, Country
-  name = name.substr(1, name.length() - 2);
-  city = parsed[2].substr(1, parsed[2].length() - 2) + ", " + parsed[3].substr(1, parsed[3].length() - 2);
+  // Removing quotation marks
+  out.key = parsed[4].substr(1, 3);
+  out.name = parsed[1].substr(1, parsed[1].length() - 2);
+  out.city = parsed[2].substr(1, parsed[2].length() - 2);
+  out.country = parsed[3].substr(1, parsed[3].length() - 2);
+  return true;
 }
 
-std::string Vertex::GetKey() const {
+}  // namespace
+
+/**
+* Parses a vertex directly out of a line of the airport dataset
+* @param csv the line of a file representing a vertex, may point into a mapped file
+* @param out the vertex to fill in
+* @return whether the line was a valid airport
+*/
+bool Vertex::Parse(std::string_view csv, Vertex& out) {
+  AirportFields fields;
+  if (!ParseAirport(csv, fields)) {
+    return false;
+  }
+  // Formating location as City, Country
+  out.key.assign(fields.key);
+  out.name.assign(fields.name);
+  out.city.assign(fields.city);
+  out.city += ", ";
+  out.city.append(fields.country);
+  out.coords = fields.coords;
+  return true;
+}
+
+/**
+* Constructs a vertex from already parsed fields
+* @param key 3 letter airport code
+* @param name airport name
+* @param city location formatted as City, Country
+* @param coords latitude and longitude
+*/
+Vertex::Vertex(const std::string& key, const std::string& name, const std::string& city, Coord coords)
+    : key(key), name(name), city(city), coords(coords) {}
+
+const std::string& Vertex::GetKey() const {
   return key;
 }
 
-std::string Vertex::GetName() const {
+const std::string& Vertex::GetName() const {
   return name;
 }
 
-std::string Vertex::GetCity() const {
+const std::string& Vertex::GetCity() const {
   return city;
 }
 
@@ -62,6 +116,34 @@ std::pair<double, double> Vertex::GetCoords() const {
   return coords;
 }
 
+VertexView::VertexView() : graph(nullptr), id(Graph::kInvalidId) {}
+
+VertexView::VertexView(const Graph* graph, uint32_t id) : graph(graph), id(id) {}
+
+bool VertexView::IsValid() const {
+  return graph != nullptr;
+}
+
+uint32_t VertexView::GetId() const {
+  return id;
+}
+
+std::string_view VertexView::GetKey() const {
+  return graph->GetCode(id);
+}
+
+std::string_view VertexView::GetName() const {
+  return graph->GetName(id);
+}
+
+std::string_view VertexView::GetCity() const {
+  return graph->GetCity(id);
+}
+
+Coord VertexView::GetCoords() const {
+  return graph->GetCoords(id);
+}
+
 /**
 * Default Edge Constructor
 */
@@ -72,21 +154,27 @@ Edge::Edge() {}
 * @param csv line of a file representing an edge
 */
 Edge::Edge(const std::string& csv) {
-  std::vector<std::string> parsed;
-  std::stringstream ss(csv);
-  while (ss.good()) {
-    std::string substring;
-    std::getline(ss, substring, ',');
-    parsed.push_back(substring);
+  std::string_view parsed[5];
+  if (SplitFields(csv, parsed, 5) < 5) {
+    throw std::invalid_argument("Invalid route");
   }
   // IATA code of source airport
-  source = parsed[2];
+  source = std::string(parsed[2]);
   // IATA code of destination airport
-  dest = parsed[4];
+  dest = std::string(parsed[4]);
   key = source + '-' + dest;
   weight = 0;
 }
 
+/**
+* Constructs an edge between two known airports
+* @param source IATA code of source airport
+* @param dest IATA code of destination airport
+* @param weight weight of the edge
+*/
+Edge::Edge(const std::string& source, const std::string& dest, double weight)
+    : key(source + '-' + dest), source(source), dest(dest), weight(weight) {}
+
 std::string Edge::GetKey() const {
   return key;
 }
@@ -107,39 +195,270 @@ void Edge::SetWeight(double new_weight) {
   weight = new_weight;
 }
 
+namespace {
+
+// A route whose endpoints are both known airports
+struct ParsedRoute {
+  uint32_t source;
+  uint32_t dest;
+  double weight;
+};
+
+/**
+* Parses and validates the routes in one chunk of the routes file. Only reads the graph's vertices, so several chunks can
+* be parsed at the same time
+* @param chunk whole lines of the routes file
+* @param graph the graph with all of its vertices loaded
+* @param out the routes with both endpoints in the graph, in file order
+*/
+void ParseRoutes(std::string_view chunk, const Graph& graph, std::vector<ParsedRoute>& out) {
+  std::string_view line;
+  std::string_view parsed[5];
+  while (NextLine(chunk, line)) {
+    if (SplitFields(line, parsed, 5) < 5) continue;
+    // IATA codes of source and destination airports
+    // checking if either endpoints aren't in list of vertices
+    uint32_t src = graph.GetId(parsed[2]);
+    uint32_t dst = graph.GetId(parsed[4]);
+    if (src == Graph::kInvalidId || dst == Graph::kInvalidId) continue;
+    // Set edge weight to distance between source and destination (according to latitude/longitude)
+    out.push_back({src, dst, Distance(graph.GetCoords(src), graph.GetCoords(dst))});
+  }
+}
+
+/**
+* Splits a file into about equal chunks that each start at the beginning of a line
+* @param contents the whole file
+* @param count the number of chunks wanted
+* @return at most count chunks covering contents in order
+*/
+std::vector<std::string_view> SplitLines(std::string_view contents, unsigned count) {
+  std::vector<std::string_view> chunks;
+  size_t target = contents.size() / count + 1;
+  while (!contents.empty()) {
+    size_t end = contents.find('\n', target);
+    end = end == std::string_view::npos ? contents.size() : end + 1;
+    chunks.push_back(contents.substr(0, end));
+    contents.remove_prefix(end);
+  }
+  return chunks;
+}
+
+}  // namespace
+
 /**
 * Constructs a graph from a file of vertices and a file of edges
 * @param vertex_file file of vertices
 * @param edge_file file of edges
+* @param options how to build the graph
 */
+Graph::Graph(const std::string& vertex_file, const std::string& edge_file, const GraphOptions& options) {
+  // Both files are scanned in place; only the fields the graph keeps are copied out
+  MappedFile vfile(vertex_file);
+  std::string_view rest = vfile.Contents();
+  std::string_view line;
+  AirportFields fields;
+  UseArena(options.arena_block_size);
+  compressed = options.compressed_adjacency;
+  ids.assign(PackedCode::kNumCodes, kInvalidId);
+  // The airports are parsed into a temporary list first, so the vertex array and the metadata arena are allocated at
+  // their exact final size. In an arena, growing or over-reserving would strand space that is never handed back
+  std::vector<AirportFields> airports;
+  std::vector<bool> seen_codes(PackedCode::kNumCodes);
+  size_t num_vertices = 0;
+  size_t metadata_size = 0;
+  while (NextLine(rest, line)) {
+    // if something went wrong with vertex parsing, don't include in the graph
+    if (!ParseAirport(line, fields)) continue;
+    airports.push_back(fields);
+    // A repeated code replaces the earlier airport but still appends its strings
+    uint16_t code = PackedCode(fields.key).Value();
+    if (!seen_codes[code]) num_vertices++;
+    seen_codes[code] = true;
+    metadata_size += fields.name.size() + fields.city.size() + 2 + fields.country.size();
+  }
+  vertices.reserve(num_vertices);
+  metadata.reserve(metadata_size);
+  for (const AirportFields& airport : airports) {
+    AddVertex(airport.key, airport.name, airport.city, airport.country, airport.coords);
+  }
 
-Graph::Graph(const std::string& vertex_file, const std::string& edge_file) {
-  std::ifstream vfilestream(vertex_file);
-  std::string line;
-  while (std::getline(vfilestream, line)) {
-    // if something went wrong with vertex creation, don't include in vertices map
-    try {
-      Vertex v(line);
-      vertices[v.GetKey()] = v;
-    } catch (const std::invalid_argument& ia) {
-      // Do nothing
+  MappedFile efile(edge_file);
+  std::vector<std::string_view> chunks = SplitLines(efile.Contents(), options.threads > 1 ? options.threads : 1);
+  std::vector<std::vector<ParsedRoute>> routes(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    // Route lines are at least 30 bytes long
+    routes[i].reserve(chunks[i].size() / 30 + 1);
+  }
+  if (chunks.size() == 1) {
+    ParseRoutes(chunks[0], *this, routes[0]);
+  } else {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      workers.emplace_back(ParseRoutes, chunks[i], std::cref(*this), std::ref(routes[i]));
     }
-    
-  }
-  line.clear();
-  std::ifstream efilestream(edge_file);
-  while (std::getline(efilestream, line)) {
-    Edge e(line);
-    // checking if either endpoints aren't in list of vertices, or that an edge with the same source/destination already exists
-    if (!vertices.count(e.GetSource()) || !vertices.count(e.GetDest()) || edges.count(e.GetKey())) {
-      continue;
+    for (auto& worker : workers) {
+      worker.join();
     }
-    Vertex source = vertices[e.GetSource()];
-    Vertex dest = vertices[e.GetDest()];
-    // Set edge weight to distance between source and destination (according to latitude/longitude)
-    e.SetWeight(Distance(source.GetCoords(), dest.GetCoords()));
-    edges[e.GetKey()] = e;
-    adj_list[e.GetSource()].push_back(e.GetDest());
+  }
+  // Merging chunks in file order keeps the first occurrence of every duplicate route, same as a serial parse. The
+  // merge buffers and the nodes of the duplicate filter come from a scratch arena released in one shot after the merge
+  size_t num_routes = 0;
+  for (const auto& chunk : routes) {
+    num_routes += chunk.size();
+  }
+  std::shared_ptr<Arena> scratch;
+  if (options.arena_block_size != 0) scratch = std::make_shared<Arena>(options.arena_block_size);
+  std::unordered_set<uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<uint64_t>> seen(
+      num_routes, std::hash<uint64_t>(), std::equal_to<uint64_t>(), ArenaAllocator<uint64_t>(scratch));
+  ArenaVector<ParsedRoute> kept{ArenaAllocator<ParsedRoute>(scratch)};
+  kept.reserve(num_routes);
+  offsets.assign(vertices.size() + 1, 0);
+  for (const auto& chunk : routes) {
+    for (const ParsedRoute& route : chunk) {
+      if (!seen.insert(uint64_t(route.source) << 32 | route.dest).second) continue;
+      kept.push_back(route);
+      offsets[route.source + 1]++;
+    }
+  }
+  // Counting sort by source keeps each vertex's edges in file order
+  for (size_t i = 0; i < vertices.size(); i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  arcs.resize(kept.size());
+  ArenaVector<uint32_t> next(offsets.begin(), offsets.end() - 1, ArenaAllocator<uint32_t>(scratch));
+  for (const ParsedRoute& route : kept) {
+    uint32_t edge = next[route.source]++;
+    arcs[edge] = {route.dest, route.weight};
+  }
+  BuildTraversalLists();
+  if (options.order != VertexOrder::kFile) {
+    Renumber(ComputeOrder(options.order));
+  }
+  BuildIndexes(options);
+}
+
+size_t MemoryBreakdown::Total() const {
+  return vertex_metadata + edge_records + adjacency + reverse_adjacency + code_index + auxiliary_indexes + arena_slack;
+}
+
+namespace {
+
+template <typename T>
+size_t Capacity(const ArenaVector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+/**
+* Adds up the memory allocated by each of the graph's containers
+* @return bytes used by each part of the graph
+*/
+MemoryBreakdown Graph::MemoryUsage() const {
+  MemoryBreakdown usage;
+  usage.vertex_metadata = Capacity(vertices) + Capacity(positions) + metadata.capacity();
+  usage.edge_records = Capacity(arcs);
+  usage.adjacency = Capacity(offsets) + Capacity(targets) + compressed_targets.MemoryUsage();
+  usage.reverse_adjacency = Capacity(in_offsets) + Capacity(sources) + compressed_sources.MemoryUsage();
+  usage.code_index = Capacity(ids);
+  usage.auxiliary_indexes = Capacity(matrix);
+  usage.arena_slack = 0;
+  // Every container of a graph shares one arena, unless the graph is a copy (see ArenaAllocator)
+  std::shared_ptr<Arena> arena = vertices.get_allocator().GetArena();
+  if (arena) usage.arena_slack = arena->BytesReserved() - usage.Total();
+  return usage;
+}
+
+/**
+* Switches the graph's containers to a new arena. Must be called while they are empty
+* @param block_size size of the arena's blocks, or 0 to use the heap
+*/
+void Graph::UseArena(size_t block_size) {
+  std::shared_ptr<Arena> arena;
+  if (block_size != 0) arena = std::make_shared<Arena>(block_size);
+  vertices = ArenaVector<VertexData>(ArenaAllocator<VertexData>(arena));
+  positions = ArenaVector<UnitVector>(ArenaAllocator<UnitVector>(arena));
+  metadata = ArenaString(ArenaAllocator<char>(arena));
+  ids = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+  offsets = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+  targets = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+  arcs = ArenaVector<Arc>(ArenaAllocator<Arc>(arena));
+  in_offsets = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+  sources = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(arena));
+  compressed_targets = VarintLists(ArenaAllocator<uint8_t>(arena));
+  compressed_sources = VarintLists(ArenaAllocator<uint8_t>(arena));
+  matrix = ArenaVector<uint64_t>(ArenaAllocator<uint64_t>(arena));
+}
+
+/**
+* Builds the vertex positions and the optional adjacency representations
+* @param options which representations to build
+*/
+void Graph::BuildIndexes(const GraphOptions& options) {
+  positions.resize(vertices.size());
+  for (uint32_t u = 0; u < vertices.size(); u++) {
+    double lat = deg2rad(vertices[u].coords.first);
+    double lon = deg2rad(vertices[u].coords.second);
+    positions[u] = {std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat)};
+  }
+  // Weights loaded from a snapshot may have been changed with SetEdgeWeight before it was saved
+  geodesic_weights = true;
+  for (uint32_t u = 0; u < vertices.size() && geodesic_weights; u++) {
+    for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+      if (arcs[edge].weight < GeodesicBound(u, arcs[edge].target)) geodesic_weights = false;
+    }
+  }
+  if (options.adjacency_matrix) {
+    matrix_words = (vertices.size() + 63) / 64;
+    matrix.assign(vertices.size() * matrix_words, 0);
+    for (uint32_t u = 0; u < vertices.size(); u++) {
+      uint64_t* row = &matrix[u * matrix_words];
+      for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+        row[arcs[edge].target / 64] |= uint64_t(1) << (arcs[edge].target % 64);
+      }
+    }
+  }
+}
+
+/**
+* Builds the destination lists used by traversals and the incoming adjacency (who flies into each airport) by
+* transposing the outgoing adjacency. Both are compressed if the graph uses compressed adjacency
+*/
+void Graph::BuildTraversalLists() {
+  uint32_t n = vertices.size();
+  // Compressed lists are encoded from temporary plain arrays on the heap
+  ArenaVector<uint32_t> plain = compressed ? ArenaVector<uint32_t>() : std::move(targets);
+  plain.resize(arcs.size());
+  for (size_t edge = 0; edge < arcs.size(); edge++) {
+    plain[edge] = arcs[edge].target;
+  }
+  if (compressed) {
+    compressed_targets.Assign(offsets.data(), n, plain.data());
+  } else {
+    targets = std::move(plain);
+  }
+
+  in_offsets.assign(n + 1, 0);
+  for (const Arc& arc : arcs) {
+    in_offsets[arc.target + 1]++;
+  }
+  for (size_t i = 0; i < n; i++) {
+    in_offsets[i + 1] += in_offsets[i];
+  }
+  // Scanning sources in id order leaves each incoming list sorted by source id
+  plain = compressed ? ArenaVector<uint32_t>() : std::move(sources);
+  plain.resize(arcs.size());
+  std::vector<uint32_t> next(in_offsets.begin(), in_offsets.end() - 1);
+  for (uint32_t u = 0; u < n; u++) {
+    for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+      plain[next[arcs[edge].target]++] = u;
+    }
+  }
+  if (compressed) {
+    compressed_sources.Assign(in_offsets.data(), n, plain.data());
+  } else {
+    sources = std::move(plain);
   }
 }
 
@@ -148,46 +467,240 @@ unsigned Graph::GetNumVertices() const {
 }
 
 unsigned Graph::GetNumEdges() const {
-  return edges.size();
+  return arcs.size();
+}
+
+uint32_t Graph::GetId(std::string_view code) const {
+  return GetId(PackedCode(code));
 }
 
-Vertex Graph::GetVertex(const std::string& code) {
-  return vertices[code];
+uint32_t Graph::GetId(PackedCode code) const {
+  return code.IsValid() ? ids[code.Value()] : kInvalidId;
 }
 
-std::vector<std::string> Graph::GetDestinations(const std::string& source) {
-  if (!adj_list.count(source)) return {};
-  return adj_list.at(source);
+std::string_view Graph::GetCode(uint32_t id) const {
+  return std::string_view(vertices[id].key, 3);
 }
 
-bool Graph::VertexExists(const std::string& key) {
-  return vertices.count(key) > 0;
+std::string_view Graph::GetName(uint32_t id) const {
+  return std::string_view(metadata).substr(vertices[id].name_offset, vertices[id].name_length);
+}
+
+std::string_view Graph::GetCity(uint32_t id) const {
+  return std::string_view(metadata).substr(vertices[id].city_offset, vertices[id].city_length);
+}
+
+Coord Graph::GetCoords(uint32_t id) const {
+  return vertices[id].coords;
+}
+
+VertexView Graph::FindVertex(std::string_view code) const {
+  uint32_t id = GetId(code);
+  return id == kInvalidId ? VertexView() : VertexView(this, id);
+}
+
+/**
+* Adds a vertex to the graph. A vertex with the same airport code as an existing one replaces it but keeps its id
+* @param key 3 character airport code
+* @param name airport name
+* @param city city of the airport
+* @param country country of the airport
+* @param coords latitude and longitude
+*/
+void Graph::AddVertex(std::string_view key, std::string_view name, std::string_view city, std::string_view country, Coord coords) {
+  uint32_t& id = ids[PackedCode(key).Value()];
+  if (id == kInvalidId) {
+    id = vertices.size();
+    vertices.emplace_back();
+  }
+  VertexData& data = vertices[id];
+  memcpy(data.key, key.data(), 3);
+  data.key[3] = '\0';
+  data.name_offset = metadata.size();
+  data.name_length = name.size();
+  metadata.append(name);
+  // Formating location as City, Country
+  data.city_offset = metadata.size();
+  data.city_length = city.size() + 2 + country.size();
+  metadata.append(city);
+  metadata += ", ";
+  metadata.append(country);
+  data.coords = coords;
+}
+
+uint32_t Graph::FindEdge(uint32_t source, uint32_t dest) const {
+  for (uint32_t edge = offsets[source]; edge < offsets[source + 1]; edge++) {
+    if (arcs[edge].target == dest) return edge;
+  }
+  return kInvalidId;
 }
 
-bool Graph::EdgeExists(const std::string& source, const std::string& dest) {
-  std::string key = source + '-' + dest;
-  return edges.count(key) > 0;
+Vertex Graph::GetVertex(const std::string& code) const {
+  uint32_t id = GetId(code);
+  if (id == kInvalidId) return Vertex();
+  return Vertex(std::string(GetCode(id)), std::string(GetName(id)), std::string(GetCity(id)), GetCoords(id));
+}
+
+std::vector<std::string> Graph::GetDestinations(const std::string& source) const {
+  DestinationRange range = Destinations(source);
+  return std::vector<std::string>(range.begin(), range.end());
+}
+
+DestinationRange Graph::Destinations(std::string_view source) const {
+  uint32_t id = GetId(source);
+  if (id == kInvalidId) return DestinationRange();
+  return DestinationRange(this, GetArcs(id));
+}
+
+Span<const Arc> Graph::GetArcs(uint32_t id) const {
+  return Span<const Arc>(arcs.data() + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+std::vector<std::string> Graph::GetOrigins(const std::string& dest) const {
+  uint32_t id = GetId(dest);
+  if (id == kInvalidId) return {};
+  std::vector<std::string> origins;
+  origins.reserve(in_offsets[id + 1] - in_offsets[id]);
+  ForEachSource(id, [&](uint32_t source) {
+    origins.emplace_back(GetCode(source));
+  });
+  return origins;
+}
+
+bool Graph::VertexExists(const std::string& key) const {
+  return GetId(key) != kInvalidId;
+}
+
+bool Graph::EdgeExists(const std::string& source, const std::string& dest) const {
+  uint32_t src = GetId(source);
+  uint32_t dst = GetId(dest);
+  return src != kInvalidId && dst != kInvalidId && EdgeExists(src, dst);
+}
+
+bool Graph::EdgeExists(uint32_t source, uint32_t dest) const {
+  if (matrix.empty()) return FindEdge(source, dest) != kInvalidId;
+  return (matrix[source * matrix_words + dest / 64] >> (dest % 64)) & 1;
+}
+
+std::vector<std::string> Graph::GetCommonDestinations(const std::string& first, const std::string& second) const {
+  uint32_t a = GetId(first);
+  uint32_t b = GetId(second);
+  std::vector<uint32_t> common;
+  if (a == kInvalidId || b == kInvalidId) return {};
+  CommonDestinations(a, b, &common);
+  std::vector<std::string> codes;
+  for (uint32_t id : common) {
+    codes.emplace_back(GetCode(id));
+  }
+  return codes;
+}
+
+unsigned Graph::CountCommonDestinations(const std::string& first, const std::string& second) const {
+  uint32_t a = GetId(first);
+  uint32_t b = GetId(second);
+  if (a == kInvalidId || b == kInvalidId) return 0;
+  return CommonDestinations(a, b, nullptr);
+}
+
+/**
+* Intersects the destinations of two vertices
+* @param first id of the first vertex
+* @param second id of the second vertex
+* @param out if not null, receives the common destinations in increasing id order
+* @return the number of common destinations
+*/
+unsigned Graph::CommonDestinations(uint32_t first, uint32_t second, std::vector<uint32_t>* out) const {
+  unsigned count = 0;
+  if (!matrix.empty()) {
+    // Whole rows are combined a word at a time; the loop has no branches on the data so it vectorizes
+    const uint64_t* row_a = &matrix[first * matrix_words];
+    const uint64_t* row_b = &matrix[second * matrix_words];
+    for (size_t word = 0; word < matrix_words; word++) {
+      uint64_t both = row_a[word] & row_b[word];
+      count += __builtin_popcountll(both);
+      if (out == nullptr) continue;
+      while (both) {
+        out->push_back(word * 64 + __builtin_ctzll(both));
+        both &= both - 1;
+      }
+    }
+    return count;
+  }
+  for (uint32_t edge = offsets[first]; edge < offsets[first + 1]; edge++) {
+    if (FindEdge(second, arcs[edge].target) == kInvalidId) continue;
+    count++;
+    if (out != nullptr) out->push_back(arcs[edge].target);
+  }
+  if (out != nullptr) std::sort(out->begin(), out->end());
+  return count;
 }
 
 void Graph::SetEdgeWeight(const std::string& source, const std::string& dest, double weight) {
-  std::string key = source + "-" + dest;
-  if (edges.count(key)) edges[key].SetWeight(weight);
+  uint32_t src = GetId(source);
+  uint32_t dst = GetId(dest);
+  if (src == kInvalidId || dst == kInvalidId) return;
+  uint32_t edge = FindEdge(src, dst);
+  if (edge == kInvalidId) return;
+  arcs[edge].weight = weight;
+  if (weight < GeodesicBound(src, dst)) geodesic_weights = false;
+}
+
+/**
+* Adds an edge to the graph
+* @param source airport code of the source vertex
+* @param dest airport code of the destination vertex
+* @return whether the edge was added
+*/
+bool Graph::AddEdge(const std::string& source, const std::string& dest) {
+  uint32_t src = GetId(source);
+  uint32_t dst = GetId(dest);
+  if (src == kInvalidId || dst == kInvalidId || FindEdge(src, dst) != kInvalidId) return false;
+  // New routes go at the end of the source's adjacency list, as if they were the last line of the routes file
+  uint32_t edge = offsets[src + 1];
+  arcs.insert(arcs.begin() + edge, Arc{dst, Distance(GetCoords(src), GetCoords(dst))});
+  for (uint32_t u = src + 1; u < offsets.size(); u++) {
+    offsets[u]++;
+  }
+  BuildTraversalLists();
+  if (!matrix.empty()) matrix[src * matrix_words + dst / 64] |= uint64_t(1) << (dst % 64);
+  return true;
+}
+
+/**
+* Removes an edge from the graph
+* @param source airport code of the source vertex
+* @param dest airport code of the destination vertex
+* @return whether the edge existed
+*/
+bool Graph::RemoveEdge(const std::string& source, const std::string& dest) {
+  uint32_t src = GetId(source);
+  uint32_t dst = GetId(dest);
+  if (src == kInvalidId || dst == kInvalidId) return false;
+  uint32_t edge = FindEdge(src, dst);
+  if (edge == kInvalidId) return false;
+  arcs.erase(arcs.begin() + edge);
+  for (uint32_t u = src + 1; u < offsets.size(); u++) {
+    offsets[u]--;
+  }
+  BuildTraversalLists();
+  if (!matrix.empty()) matrix[src * matrix_words + dst / 64] &= ~(uint64_t(1) << (dst % 64));
+  return true;
 }
 
 /**
 * Creates a breadth-first traversal for the graph
 * @return a vector of keys in the order nodes were visited
 */
-std::vector<std::string> Graph::BFS() {
-  // Stores the keys of all visited nodes
-  std::unordered_set<std::string> visited;
+std::vector<std::string> Graph::BFS() const {
+  // Marks the ids of all visited nodes
+  std::vector<bool> visited(vertices.size());
   // Stores the keys of all node keys in order visited
   std::vector<std::string> v;
-  for (const auto& vertex : vertices) {
+  for (uint32_t id = 0; id < vertices.size(); id++) {
     // Checking for connected components
     // If vertex has already been visited, do nothing as it belongs to a connected component that has already been explored
-    if (visited.count(vertex.first)) continue;
-    BFS(vertex.first, v, visited);
+    if (visited[id]) continue;
+    BFS(id, v, visited);
   }
   return v;
 }
@@ -195,38 +708,65 @@ std::vector<std::string> Graph::BFS() {
 /**
 * Creates a breadth-first traversal for the graph starting at a given node
 * @param start the start point of the BFS
-* @return a vector of keys in the order nodes were visited
+* @return a vector of keys in the order nodes were visited, empty if start is not in the graph
 */
-std::vector<std::string> Graph::BFS(const std::string& start) {
+std::vector<std::string> Graph::BFS(const std::string& start) const {
   std::vector<std::string> v;
-  std::unordered_set<std::string> visited;
-  BFS(start, v, visited);
+  uint32_t id = GetId(start);
+  if (id == kInvalidId) return v;
+  std::vector<bool> visited(vertices.size());
+  BFS(id, v, visited);
   return v;
 }
 
 /**
-* Helper function for the BFS traversal
+* Creates a breadth-first traversal for the graph starting at a given node, expanding each level with several threads
 * @param start the start point of the BFS
+* @param threads number of threads
+* @return a vector of keys level by level, in id order within a level, empty if start is not in the graph
+*/
+std::vector<std::string> Graph::BFS(const std::string& start, unsigned threads) const {
+  uint32_t id = GetId(start);
+  if (id == kInvalidId) return {};
+  BFSTree tree = ParallelBFSLevels(id, threads);
+  // Counting sort of the reached vertices by level
+  std::vector<uint32_t> level_start;
+  for (uint32_t level : tree.levels) {
+    if (level == BFSTree::kUnreached) continue;
+    if (level + 1 >= level_start.size()) level_start.resize(level + 2, 0);
+    level_start[level + 1]++;
+  }
+  for (size_t level = 1; level < level_start.size(); level++) {
+    level_start[level] += level_start[level - 1];
+  }
+  std::vector<std::string> v(level_start.back());
+  for (uint32_t u = 0; u < vertices.size(); u++) {
+    if (tree.levels[u] == BFSTree::kUnreached) continue;
+    v[level_start[tree.levels[u]]++] = std::string(GetCode(u));
+  }
+  return v;
+}
+
+/**
+* Helper function for the BFS traversal
+* @param start the id of the start point of the BFS
 * @param v the vector of keys in the order nodes were visted
-* @param visted the set of keys that have already been visited
+* @param visted marks the ids that have already been visited
 */
-void Graph::BFS(const std::string& start, std::vector<std::string>& v, std::unordered_set<std::string>& visited) {
-  std::queue<std::string> q;
+void Graph::BFS(uint32_t start, std::vector<std::string>& v, std::vector<bool>& visited) const {
+  std::queue<uint32_t> q;
   q.push(start);
-  visited.insert(start);
+  visited[start] = true;
   while (!q.empty()) {
-    std::string curr = q.front();
+    uint32_t curr = q.front();
     q.pop();
-    v.push_back(curr);
-    if (!adj_list.count(curr)) continue;
+    v.emplace_back(GetCode(curr));
     // Visit all unvisited neighbors of curr and push to queue
-    for (const auto& neighbor : adj_list.at(curr)) {
-      // key format: "[source vertex key]-[destination vertex key]""
-      std::string key = curr + "-" + neighbor;
-      if (visited.count(neighbor)) continue;
-      visited.insert(neighbor);
+    ForEachTarget(curr, [&](uint32_t neighbor) {
+      if (visited[neighbor]) return;
+      visited[neighbor] = true;
       q.push(neighbor);
-    }
+    });
   }
 }
 
@@ -236,120 +776,125 @@ void Graph::BFS(const std::string& start, std::vector<std::string>& v, std::unor
 * @param end the endpoint of the path
 * @return a pair of a string representing the shortest path and the distance of the shortest path
 */
-std::pair<std::string, double> Graph::Dijkstras(const std::string& start, const std::string& end) {
-  // reference: https://courses.grainger.illinois.edu/cs225/fa2020/resources/dijkstra/
+std::pair<std::string, double> Graph::Dijkstras(const std::string& start, const std::string& end) const {
   const double INF = std::numeric_limits<double>::max();
-  // Using (ordered) set to represent priority queue
-  std::set<std::pair<double, std::string>> pq;
-  // Maps node to its predecessor
-  std::unordered_map<std::string, std::string> previous;
-  std::unordered_set<std::string> visited;
-  std::unordered_map<std::string, double> distance;
-
-  for (const auto & v : vertices) {
-    pq.insert(std::pair<double, std::string>(INF, v.first));
-    distance[v.first] = INF;
-  }
-
-  // Update start distance to be 0
-  distance[start] = 0;
-  // To update, we remove old entry in priority queue and add the entry with the updated distance
-  pq.erase(std::pair<double, std::string>(INF, start));
-  pq.insert(std::pair<double, std::string>(0, start));
-
-  while (!pq.empty() && (*pq.begin()).second != end) {
-    auto curr = *pq.begin();
-    pq.erase(curr);
-    visited.insert(curr.second);
-    if (!adj_list.count(curr.second)) continue;
-    for (const auto& neighbor : adj_list.at(curr.second)) {
-      if (visited.count(neighbor)) continue;
-      std::string edge_key = curr.second + "-" + neighbor;
-      double new_dist = curr.first + edges.at(edge_key).GetWeight();
-      if (new_dist < distance.at(neighbor)) {
-        previous[neighbor] = curr.second;
-        double prev_dist = distance.at(neighbor);
-        distance[neighbor] = new_dist;
-        pq.erase(std::pair<double, std::string>(prev_dist, neighbor));
-        pq.insert(std::pair<double, std::string>(new_dist, neighbor));
-      }
-    }
-    
+  uint32_t source = GetId(start);
+  uint32_t target = GetId(end);
+  if (source == kInvalidId || target == kInvalidId) {
+    return std::make_pair("No path found", INF);
   }
-  std::string path_string;
-  if (distance.at(end) == INF) {
-    path_string = "No path found";
+  ShortestPath route = ShortestRoute(source, target);
+  if (route.vertices.empty()) {
+    return std::make_pair("No path found", INF);
   }
-  // Reconstructing the path from previous
-  std::string curr = end;
-  std::vector<std::string> path;
-  while (previous.count(curr)) {
-    curr = previous.at(curr);
-    path.push_back(curr);
+  std::string path_string;
+  for (uint32_t node : route.vertices) {
+    if (!path_string.empty()) path_string += " -> ";
+    path_string += GetCode(node);
   }
-  std::reverse(path.begin(), path.end());
-  
-  for (std::string node : path) {
-    path_string += node;
-    path_string += " -> ";
+  return std::make_pair(path_string, route.distance);
+}
+
+/**
+* Finds the shortest path between two vertex ids with a priority queue chosen at run time
+* @param source id of the starting point of the path
+* @param target id of the endpoint of the path
+* @param policy the priority queue to use
+* @return the route, its distance and the number of vertices settled
+*/
+ShortestPath Graph::ShortestRoute(uint32_t source, uint32_t target, QueuePolicy policy) const {
+  switch (policy) {
+    case QueuePolicy::kQuaternaryHeap:
+      return ShortestRoute<QuaternaryHeapQueue>(source, target);
+    case QueuePolicy::kPairingHeap:
+      return ShortestRoute<PairingHeapQueue>(source, target);
+    case QueuePolicy::kRadixHeap:
+      return ShortestRoute<RadixHeapQueue>(source, target);
+    default:
+      return ShortestRoute<BinaryHeapQueue>(source, target);
   }
-  if (path_string != "No path found") {
-    path_string += end;
+}
+
+/**
+* Finds a route between two vertex ids with A* search, with the priority queue chosen at run time
+* @param source id of the starting point of the path
+* @param target id of the endpoint of the path
+* @param weight factor applied to the great-circle heuristic, 1 for a shortest route
+* @param policy the priority queue to use
+* @return the route, its distance and the number of vertices settled
+*/
+ShortestPath Graph::AStarRoute(uint32_t source, uint32_t target, double weight, QueuePolicy policy) const {
+  SearchWorkspace& workspace = SearchWorkspace::Local();
+  switch (policy) {
+    case QueuePolicy::kQuaternaryHeap:
+      return AStarRoute<QuaternaryHeapQueue>(source, target, weight, workspace);
+    case QueuePolicy::kPairingHeap:
+      return AStarRoute<PairingHeapQueue>(source, target, weight, workspace);
+    case QueuePolicy::kRadixHeap:
+      return AStarRoute<RadixHeapQueue>(source, target, weight, workspace);
+    default:
+      return AStarRoute<BinaryHeapQueue>(source, target, weight, workspace);
   }
+}
 
-  return std::make_pair(path_string, distance.at(end));
+bool Graph::HasGeodesicWeights() const {
+  return geodesic_weights;
 }
 
 /**
 * PageRank algorithm to calculate the popularity of airports in the graph, based on flight legs
 * @return a map of each airport key to its rank and sorted list of pagerank score/airport code pairs from highest score to lowest
 */
-std::pair<std::unordered_map<std::string, double>, std::vector<std::pair<double, std::string>>> Graph::PageRank() {
+std::pair<std::unordered_map<std::string, double>, std::vector<std::pair<double, std::string>>> Graph::PageRank() const {
   // reference: https://courses.cs.washington.edu/courses/cse373/17au/project3/project3-3.html
   double epsilon = 0.000005;
   double decay = 0.85;
   bool converged = false;
-  std::unordered_map<std::string, double> ranking;
-  std::unordered_map<std::string, double> previous;
-  for (const auto & v : vertices) {
-    ranking.insert(std::make_pair(v.first, 1.0 / vertices.size()));
-  }
+  size_t n = vertices.size();
+  std::vector<double> ranking(n, 1.0 / n);
+  std::vector<double> previous(n);
+  // Rank each vertex passes along every one of its outgoing edges in the current iteration
+  std::vector<double> contribution(n);
   while (!converged) {
     double no_outgoing = 0;
-    previous = ranking;
-    for (auto & r : ranking) {
-      r.second = 0;
-    }
-    for (const auto & r : ranking) {
+    ranking.swap(previous);
+    for (uint32_t u = 0; u < n; u++) {
+      uint32_t connections = offsets[u + 1] - offsets[u];
       // Keeping track of cumulative old page rank from nodes with nodes with no outgoing edges
-      if (!adj_list.count(r.first)) {
-        no_outgoing += previous[r.first];
+      if (connections == 0) {
+        no_outgoing += previous[u];
+        contribution[u] = 0;
         continue;
       }
-      for (const std::string & v : adj_list[r.first]) {
-        int connections = adj_list[r.first].size();
-        ranking[v] += decay * previous[r.first] / connections;
-      }
+      contribution[u] = decay * previous[u] / connections;
     }
-    for (auto & r : ranking) {
-      // Adding d * cumulative old rank from nodes without outgoing edges / N to all vertices 
-      r.second += decay * no_outgoing / vertices.size();
-      r.second += (1.0 - decay) / vertices.size();
+    // Each vertex pulls rank over its incoming edges, so every rank is written exactly once
+    for (uint32_t v = 0; v < n; v++) {
+      double r = 0;
+      ForEachSource(v, [&](uint32_t source) {
+        r += contribution[source];
+      });
+      // Adding d * cumulative old rank from nodes without outgoing edges / N to all vertices
+      r += decay * no_outgoing / n;
+      r += (1.0 - decay) / n;
+      ranking[v] = r;
     }
     converged = true;
-    for (const auto & r : ranking) {
-      if (abs(r.second - previous[r.first]) > epsilon) {
+    for (uint32_t u = 0; u < n; u++) {
+      if (std::abs(ranking[u] - previous[u]) > epsilon) {
         converged = false;
         break;
       }
     }
   }
 
+  std::unordered_map<std::string, double> ranks;
   std::vector<std::pair<double, std::string>> sorted;
-  for (const auto & elem : ranking) {
-    sorted.push_back(std::make_pair(elem.second, elem.first));
+  for (uint32_t u = 0; u < n; u++) {
+    ranks.emplace(GetCode(u), ranking[u]);
+    sorted.emplace_back(ranking[u], GetCode(u));
   }
   std::sort(sorted.begin(), sorted.end(), std::greater<>());
 
-  return std::make_pair(ranking, sorted);
-}
\ No newline at end of file
+  return std::make_pair(ranks, sorted);
+}
@@ -1,22 +1,37 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <set>
 #include <map>
 
+#include "arena.h"
+#include "priority_queues.h"
+#include "search_workspace.h"
 #include "utils.h"
+#include "varint_lists.h"
 
 class Vertex {
   public:
     Vertex();
     // Constructs a vertex from one line from airport dataset
     Vertex(const std::string& csv);
-    std::string GetKey() const;
-    std::string GetName() const;
-    std::string GetCity() const;
+    // Parses one line from airport dataset in place without throwing
+    // Returns false if the line does not describe a valid airport, in which case out is unspecified
+    static bool Parse(std::string_view csv, Vertex& out);
+    Vertex(const std::string& key, const std::string& name, const std::string& city, Coord coords);
+    const std::string& GetKey() const;
+    const std::string& GetName() const;
+    const std::string& GetCity() const;
     Coord GetCoords() const;
   private:
     // 3 letter airport code
@@ -30,6 +45,7 @@ class Edge {
     Edge();
     // Constructs an edge from one line from routes dataset
     Edge(const std::string& csv);
+    Edge(const std::string& source, const std::string& dest, double weight);
     std::string GetKey() const;
     std::string GetSource() const;
     std::string GetDest() const;
@@ -42,35 +58,618 @@ class Edge {
     std::string dest;
     double weight;
 };
+// An outgoing edge stored inline in the adjacency arrays
+struct Arc {
+  // Destination vertex id
+  uint32_t target;
+  double weight;
+};
+
+class Graph;
+class BFSTraversal;
+
+// Lightweight handle to a vertex of a graph. The strings returned by its getters point into the graph's metadata
+// arena and stay valid for the lifetime of the graph
+class VertexView {
+  public:
+    // Constructs a view that refers to no vertex
+    VertexView();
+    // Whether the view refers to a vertex (false when a lookup did not find the airport)
+    bool IsValid() const;
+    uint32_t GetId() const;
+    std::string_view GetKey() const;
+    std::string_view GetName() const;
+    std::string_view GetCity() const;
+    Coord GetCoords() const;
+  private:
+    friend class Graph;
+    friend class BFSTraversal;
+    VertexView(const Graph* graph, uint32_t id);
+    const Graph* graph;
+    uint32_t id;
+};
+
+// Airport codes of the destinations of a run of edges, read from the graph as they are iterated without copying
+// Valid until the graph is modified or destroyed. The iterators are input iterators: dereferencing yields the code by
+// value, so algorithms must not rely on references to it staying valid
+class DestinationRange {
+  public:
+    class Iterator {
+      public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::string_view value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::string_view* pointer;
+        typedef std::string_view reference;
+        Iterator(const Graph* graph, const Arc* arc) : graph(graph), arc(arc) {}
+        std::string_view operator*() const;
+        Iterator& operator++() {
+          arc++;
+          return *this;
+        }
+        Iterator operator++(int) {
+          Iterator previous = *this;
+          arc++;
+          return previous;
+        }
+        bool operator==(const Iterator& other) const {
+          return arc == other.arc;
+        }
+        bool operator!=(const Iterator& other) const {
+          return arc != other.arc;
+        }
+      private:
+        const Graph* graph;
+        const Arc* arc;
+    };
+    // Constructs an empty range
+    DestinationRange() : graph(nullptr) {}
+    Iterator begin() const {
+      return Iterator(graph, arcs.begin());
+    }
+    Iterator end() const {
+      return Iterator(graph, arcs.end());
+    }
+    size_t size() const {
+      return arcs.size();
+    }
+    bool empty() const {
+      return arcs.empty();
+    }
+  private:
+    friend class Graph;
+    DestinationRange(const Graph* graph, Span<const Arc> arcs) : graph(graph), arcs(arcs) {}
+    const Graph* graph;
+    Span<const Arc> arcs;
+};
+
+// Breadth-first traversal from one vertex that does work only as it is consumed: advancing the iterator expands one
+// vertex. Visits the same airports in the same order as Graph::BFS(start), so taking the first k costs O(k) vertex
+// expansions instead of a full traversal. Single pass: the traversal state lives in this object, and its iterators
+// all refer to it. Valid until the graph is modified or destroyed
+class BFSTraversal {
+  public:
+    class Iterator {
+      public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef VertexView value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const VertexView* pointer;
+        typedef VertexView reference;
+        explicit Iterator(BFSTraversal* traversal) : traversal(traversal) {}
+        VertexView operator*() const {
+          return traversal->Current();
+        }
+        Iterator& operator++() {
+          traversal->Next();
+          return *this;
+        }
+        void operator++(int) {
+          traversal->Next();
+        }
+        // Every iterator that is not at the end compares equal to the current position
+        bool operator==(const Iterator& other) const {
+          return AtEnd() == other.AtEnd();
+        }
+        bool operator!=(const Iterator& other) const {
+          return AtEnd() != other.AtEnd();
+        }
+      private:
+        bool AtEnd() const {
+          return traversal == nullptr || traversal->Done();
+        }
+        BFSTraversal* traversal;
+    };
+    Iterator begin() {
+      return Iterator(this);
+    }
+    Iterator end() {
+      return Iterator(nullptr);
+    }
+    // Whether every reachable vertex has been visited
+    bool Done() const;
+    // The vertex the traversal is at
+    VertexView Current() const;
+    // Moves to the next vertex, queueing the unvisited neighbors of the current one
+    void Next();
+  private:
+    friend class Graph;
+    BFSTraversal(const Graph* graph, uint32_t start);
+    const Graph* graph;
+    // Vertices in visit order. Entries from head on are queued but not yet visited
+    std::vector<uint32_t> queue;
+    size_t head;
+    std::vector<uint64_t> visited;
+};
+
+// How vertex ids are assigned when a graph is loaded
+enum class VertexOrder {
+  // Order of first appearance in the airport file, or the order stored in a snapshot
+  kFile,
+  // Reverse Cuthill-McKee: breadth-first over the undirected graph, so neighbors get nearby ids
+  kRCM,
+  // Highest total degree first, so hub data is packed together
+  kDegree,
+  // Along a Hilbert curve over latitude/longitude, so nearby airports get nearby ids
+  kHilbert
+};
+
+// How well the vertex numbering keeps the data of neighboring vertices close in memory
+struct LocalityStats {
+  // Mean |u - v| over all edges u->v
+  double mean_edge_span;
+  // Fraction of edges whose endpoints' 8 byte per-vertex values share a 64 byte cache line
+  double same_line_fraction;
+  // Miss rate of a simulated 32 KB, 8-way set associative LRU cache over the per-vertex reads of one pull-based
+  // PageRank iteration. An estimate of the data cache behavior of the traversals, not a hardware measurement
+  double simulated_miss_rate;
+};
+
+// Bytes of heap memory held by each part of a graph, counting the allocated capacity of every container
+struct MemoryBreakdown {
+  // Vertex records, their positions as unit vectors and the metadata arena holding names and cities
+  size_t vertex_metadata;
+  // Inline (target, weight) records of every edge
+  size_t edge_records;
+  // Outgoing adjacency offsets and destination ids
+  size_t adjacency;
+  // Incoming adjacency offsets and source ids
+  size_t reverse_adjacency;
+  // Airport code to id table. This replaced every hash table in the graph, so there is no per-node hash overhead
+  size_t code_index;
+  // Optional indexes such as the bit matrix
+  size_t auxiliary_indexes;
+  // Space reserved in the graph's arena blocks but not used by any container
+  size_t arena_slack;
+  size_t Total() const;
+};
+
+// How a single-source breadth-first search expands each level
+enum class BFSStrategy {
+  // Every frontier vertex scans its outgoing edges
+  kTopDown,
+  // While the frontier is large, levels are expanded bottom-up instead: every unvisited vertex scans its incoming edges
+  // and stops at the first one from the frontier. Hubs put most of a small-world graph within a few large levels, where
+  // this looks at far fewer edges
+  kDirectionOptimizing
+};
+
+// Result of a breadth-first search from one vertex
+struct BFSTree {
+  // Level of a vertex the search did not reach
+  static constexpr uint32_t kUnreached = UINT32_MAX;
+  // Number of legs from the start to each vertex id, kUnreached if there is no path
+  std::vector<uint32_t> levels;
+  // Vertex each vertex was first reached from, one level closer to the start. Graph::kInvalidId for the start and
+  // unreached vertices
+  std::vector<uint32_t> parents;
+  // Number of edges the search looked at
+  uint64_t edges_examined;
+};
+
+// A vertex found by a hop-limited search
+struct ReachedVertex {
+  uint32_t id;
+  // Legs on a shortest route from the start
+  uint32_t hops;
+  // Vertex it was reached from on that route, Graph::kInvalidId for the start
+  uint32_t parent;
+};
+
+// Partition of the vertices into connected components
+struct Components {
+  // Component of each vertex id, numbered from 0
+  std::vector<uint32_t> component;
+  // Number of vertices in each component
+  std::vector<uint32_t> sizes;
+};
+
+// Hop distances within the largest strongly connected component, the airports that can all reach each other. The
+// eccentricity of an airport is the most legs it needs to reach any airport of the component
+struct EccentricityStats {
+  // Id of the component in StronglyConnectedComponents()
+  uint32_t component;
+  // Longest shortest route between two airports of the component, exact
+  uint32_t diameter;
+  // Bounds on the smallest eccentricity in the component
+  uint32_t radius_lower;
+  uint32_t radius_upper;
+  // Bounds on the eccentricity of every vertex id, BFSTree::kUnreached for vertices outside the component
+  std::vector<uint32_t> eccentricity_lower;
+  std::vector<uint32_t> eccentricity_upper;
+  // Searches run to find the exact diameter and to bound the eccentricities, each one forward or backward
+  uint32_t diameter_bfs_runs;
+  uint32_t sample_bfs_runs;
+};
+
+// Priority queue used by a shortest path search (see priority_queues.h)
+enum class QueuePolicy {
+  kBinaryHeap,
+  kQuaternaryHeap,
+  kPairingHeap,
+  kRadixHeap
+};
+
+// Route found by a shortest path search
+struct ShortestPath {
+  // Vertex ids from the start to the end, empty if there is no route
+  std::vector<uint32_t> vertices;
+  // Total weight of the route, std::numeric_limits<double>::max() if there is none
+  double distance;
+  // Number of vertices the search settled (took off the queue with their final distance)
+  uint32_t settled;
+};
+
+// Number of legs on a shortest route between every ordered pair of vertices, one byte per pair
+class HopMatrix {
+  public:
+    // Hop count of a pair with no path
+    static constexpr uint8_t kUnreachable = 255;
+    HopMatrix();
+    uint32_t GetNumVertices() const;
+    // Legs from one vertex id to another, kUnreachable if there is no path. Counts above 254 are stored as 254
+    uint8_t Get(uint32_t from, uint32_t to) const;
+    // Number of ordered pairs of distinct vertices at each hop count, indexed by hop count. Unreachable pairs are not
+    // counted
+    std::vector<uint64_t> CountPairsByHops() const;
+  private:
+    friend class Graph;
+    uint32_t size;
+    // Row per source vertex
+    std::vector<uint8_t> hops;
+};
+
+// Options controlling how a graph is built from the dataset files
+struct GraphOptions {
+  // Number of threads used to parse the routes file. Routes are split into newline-aligned chunks that are parsed
+  // concurrently and merged in file order, so the resulting graph is the same for any thread count
+  unsigned threads = 1;
+  // Also store the adjacency as a bit matrix (one bit per vertex pair, GetNumVertices()^2 / 8 bytes, about 4.5 MB for
+  // the OpenFlights data) so that EdgeExists and common destination queries are branch-free bit operations
+  bool adjacency_matrix = false;
+  // Renumbering of the vertices, applied before the adjacency indexes are built
+  VertexOrder order = VertexOrder::kFile;
+  // Store the id-only adjacency lists used by traversals (BFS, PageRank) gap and varint encoded instead of as 32 bit
+  // ids, which is several times smaller and is decoded on the fly. Traversals then visit each vertex's neighbors in id
+  // order instead of file order. Weighted searches and GetDestinations still use the edge records, in file order
+  bool compressed_adjacency = false;
+  // Size of the blocks the graph and its indexes are allocated from. The whole graph lives in a few large blocks that are
+  // freed at once when it is destroyed, and scratch buffers used while loading come from a separate arena freed at the
+  // end of the load. Copies of a graph allocate from the heap. 0 allocates every container from the heap. Arrays over a
+  // quarter of a block get a block of their own, so with 64 KB blocks every array of the OpenFlights graph is allocated
+  // at its exact size and no block is left partly empty
+  size_t arena_block_size = 1 << 16;
+};
 class Graph {
   public:
-    Graph(const std::string& vertex_file, const std::string& edge_file);
+    Graph(const std::string& vertex_file, const std::string& edge_file, const GraphOptions& options = GraphOptions());
+    // Marks an airport code that is not in the graph
+    static constexpr uint32_t kInvalidId = UINT32_MAX;
     unsigned GetNumVertices() const;
     unsigned GetNumEdges() const;
-    // Gets vertex from airport code
-    Vertex GetVertex(const std::string& code);
+    // Vertices are numbered with dense ids in [0, GetNumVertices()), in the order chosen by GraphOptions::order (file
+    // order by default)
+    // Gets the id of an airport code, or kInvalidId if the airport is not in the graph
+    uint32_t GetId(std::string_view code) const;
+    // Metadata of a vertex id. Strings point into the graph's metadata arena and stay valid for the lifetime of the graph
+    std::string_view GetCode(uint32_t id) const;
+    std::string_view GetName(uint32_t id) const;
+    std::string_view GetCity(uint32_t id) const;
+    Coord GetCoords(uint32_t id) const;
+    // Looks up a vertex without copying it. Returns an invalid view if the airport is not in the graph
+    VertexView FindVertex(std::string_view code) const;
+    // Gets a copy of the vertex with an airport code, or a default vertex if the airport is not in the graph
+    Vertex GetVertex(const std::string& code) const;
     // Gets all vertices where an edge exists from the source to the vertex
-    std::vector<std::string> GetDestinations(const std::string& source);
-    bool VertexExists(const std::string& key);
-    bool EdgeExists(const std::string& source, const std::string& dest);
+    std::vector<std::string> GetDestinations(const std::string& source) const;
+    // Iterates the destination codes of an airport in file order without allocating, empty if the airport is not in
+    // the graph. Valid until the graph is modified or destroyed
+    DestinationRange Destinations(std::string_view source) const;
+    // Outgoing edges of a vertex id in file order, as (destination id, weight) records read in place
+    // Valid until the graph is modified or destroyed
+    Span<const Arc> GetArcs(uint32_t id) const;
+    // Gets all vertices where an edge exists from the vertex to the destination
+    std::vector<std::string> GetOrigins(const std::string& dest) const;
+    bool VertexExists(const std::string& key) const;
+    bool EdgeExists(const std::string& source, const std::string& dest) const;
+    bool EdgeExists(uint32_t source, uint32_t dest) const;
+    // Gets the airports with a direct flight from both first and second
+    std::vector<std::string> GetCommonDestinations(const std::string& first, const std::string& second) const;
+    // Counts the airports with a direct flight from both first and second
+    unsigned CountCommonDestinations(const std::string& first, const std::string& second) const;
     void SetEdgeWeight(const std::string& source, const std::string& dest, double weight);
+    // Adds a route between two airports of the graph, weighted by their distance
+    // Returns false if either airport is not in the graph or the route already exists
+    // Rebuilds the adjacency indexes, so it is meant for applying changes to a new version of a graph (see GraphStore)
+    bool AddEdge(const std::string& source, const std::string& dest);
+    // Removes a route, returns false if it does not exist. Rebuilds the adjacency indexes like AddEdge
+    bool RemoveEdge(const std::string& source, const std::string& dest);
     // Traverses the whole graph including all connected components by looping through all vertices and performing and individual
     // BFS traversal starting at each unvisited vertex
     // Returns a vector of vertex keys (airport codes) in the order visited by the traversal
-    std::vector<std::string> BFS();
+    std::vector<std::string> BFS() const;
     // Individual BFS traversal starting at specified point. Will not visit every node in graph if graph is not strongly connected
     // Returns a vector of vertex keys (airport codes) in the order visited by the traversal
-    std::vector<std::string> BFS(const std::string& start);
+    std::vector<std::string> BFS(const std::string& start) const;
+    // Same as BFS(start) with each level expanded by several threads. Airports are returned level by level like the
+    // serial traversal, but in id order within each level instead of visit order
+    std::vector<std::string> BFS(const std::string& start, unsigned threads) const;
+    // Breadth-first search over vertex ids, giving the hop level and a parent of every vertex
+    // Levels are the same for every strategy. Parents can differ when a vertex has several neighbors in the previous level
+    BFSTree BFSLevels(uint32_t start, BFSStrategy strategy = BFSStrategy::kDirectionOptimizing) const;
+    // Top-down BFSLevels with the frontier split between threads. Gives the same levels as the serial search; parents
+    // can differ, and edges_examined is the same as a top-down search
+    BFSTree ParallelBFSLevels(uint32_t start, unsigned threads) const;
+    // Gets every airport reachable from code in at most max_legs flights (max_legs - 1 connections), including code
+    // itself with 0 hops, in breadth-first order. The search stops as soon as the last allowed level is found, so the cost
+    // depends on the size of the answer rather than of the graph. Empty if code is not in the graph
+    std::vector<ReachedVertex> ReachableWithin(std::string_view code, unsigned max_legs) const;
+    // Hop counts between all pairs of vertices. Searches run from 64 sources at once, one bit per source in a word per
+    // vertex, so each edge is scanned once per level for the whole batch. Batches are split between threads
+    HopMatrix AllPairsHops(unsigned threads = 1) const;
+    // Lazy version of BFS(start) for reading part of a traversal. Empty if start is not in the graph
+    BFSTraversal Traverse(std::string_view start) const;
     // Performs Dijkstra's algorithm to find the shortest path from start to end or to determine that no path exists
     // Returns a string representation of the shortest path or an indication that no path was found
     // Returns the distance corresponding the the shortest path (or infinity if no path found)
-    std::pair<std::string, double> Dijkstras(const std::string& start, const std::string& end);
+    std::pair<std::string, double> Dijkstras(const std::string& start, const std::string& end) const;
+    // Dijkstra's algorithm between vertex ids with the queue chosen at compile time, one of the policies in
+    // priority_queues.h. The search state lives in workspace, so it allocates nothing once the workspace has grown to
+    // the graph, and only the vertices it reaches are touched
+    template <typename Queue>
+    ShortestPath ShortestRoute(uint32_t source, uint32_t target, SearchWorkspace& workspace) const;
+    // Same search in the calling thread's workspace (SearchWorkspace::Local())
+    template <typename Queue>
+    ShortestPath ShortestRoute(uint32_t source, uint32_t target) const;
+    // Same search with the queue chosen at run time, for comparing the policies. Every policy finds a route of the same
+    // distance; routes can differ between policies when several have exactly the same distance
+    ShortestPath ShortestRoute(uint32_t source, uint32_t target, QueuePolicy policy = QueuePolicy::kBinaryHeap) const;
+    // A* search between vertex ids. Vertices are expanded in order of their distance from the source plus weight times
+    // their great-circle distance to the target, which is a lower bound on the rest of the route since every edge is
+    // weighted by the great-circle distance between its airports. With weight 1 the route is a shortest one, but far
+    // fewer vertices are settled than by ShortestRoute. A larger weight settles fewer still and finds a route at most
+    // weight times longer than a shortest one. If a weight set with SetEdgeWeight breaks the bound (see
+    // HasGeodesicWeights), the search falls back to Dijkstra's algorithm
+    // Throws std::invalid_argument if weight is below 1
+    template <typename Queue>
+    ShortestPath AStarRoute(uint32_t source, uint32_t target, double weight, SearchWorkspace& workspace) const;
+    // Same search in the calling thread's workspace with the queue chosen at run time
+    ShortestPath AStarRoute(uint32_t source, uint32_t target, double weight = 1,
+                            QueuePolicy policy = QueuePolicy::kBinaryHeap) const;
+    // Whether every edge weight is at least the great-circle distance between its airports, which makes that distance a
+    // valid A* heuristic. True unless SetEdgeWeight made a route shorter than its great circle
+    bool HasGeodesicWeights() const;
     // Performs PageRank and returns a map of each airport code to PageRank score, as well as a sorted list of airport codes ranked from
     // highest to lowest score (most to least popular airports according to the algorithm)
-    std::pair<std::unordered_map<std::string, double>, std::vector<std::pair<double, std::string>>> PageRank();
+    std::pair<std::unordered_map<std::string, double>, std::vector<std::pair<double, std::string>>> PageRank() const;
+    // Strongly connected components: two airports are in the same component if each can be reached from the other
+    // Components are numbered in reverse topological order, so every route leads to a component with the same or a
+    // lower number. Uses Tarjan's algorithm with an explicit stack, so deep graphs cannot overflow the call stack
+    Components StronglyConnectedComponents() const;
+    // Weakly connected components: airports connected when route directions are ignored. If two airports are in
+    // different weak components, no route exists between them in either direction. Numbered in order of lowest vertex id
+    Components WeaklyConnectedComponents() const;
+    // Measures the hop diameter of the largest strongly connected component exactly, and bounds its radius and the
+    // eccentricity of each of its airports from a forward and a backward search from each of samples airports. The
+    // samples are split between threads
+    EccentricityStats Eccentricities(unsigned samples = 16, unsigned threads = 1) const;
+    // Gets the memory used by each part of the graph
+    MemoryBreakdown MemoryUsage() const;
+    // Measures how well the current vertex numbering keeps neighbors together in memory
+    LocalityStats GetLocalityStats() const;
+    // Writes the fully built graph (vertices, edges with their current weights, adjacency order) to a binary snapshot
+    // Throws std::runtime_error if the file cannot be written
+    void SaveSnapshot(const std::string& path) const;
+    // Loads a graph written by SaveSnapshot without parsing the dataset or recomputing distances
+    // Throws std::runtime_error if the file is missing, from an incompatible version, or corrupted
+    static Graph LoadSnapshot(const std::string& path, const GraphOptions& options = GraphOptions());
   private:
-    std::unordered_map<std::string, Vertex> vertices;
-    std::unordered_map<std::string, Edge> edges;
-    std::unordered_map<std::string, std::vector<std::string>> adj_list;
-    void BFS(const std::string& start, std::vector<std::string>& v, std::unordered_set<std::string>& visited);
-};
\ No newline at end of file
+    // Metadata of one vertex. Names and cities are slices of the metadata arena
+    struct VertexData {
+      // 3 character airport code, null terminated
+      char key[4];
+      uint32_t name_offset;
+      uint32_t name_length;
+      uint32_t city_offset;
+      uint32_t city_length;
+      Coord coords;
+    };
+    Graph() = default;
+    // Makes the (empty) containers allocate from a new arena with blocks of block_size bytes, or from the heap if 0
+    void UseArena(size_t block_size);
+    // Point on the unit sphere (x, y, z) of an airport's coordinates
+    struct UnitVector {
+      double x;
+      double y;
+      double z;
+    };
+    // Vertices indexed by id
+    ArenaVector<VertexData> vertices;
+    // Position of each vertex id, so great-circle distances in searches cost two square roots and an arctangent instead
+    // of the trigonometry of Distance()
+    ArenaVector<UnitVector> positions;
+    // Whether no edge weight is below the great-circle distance between its endpoints (HasGeodesicWeights)
+    bool geodesic_weights = true;
+    // Every airport name and city (formatted as City, Country) stored back to back, so loading a graph allocates one
+    // buffer for all strings instead of several per vertex
+    ArenaString metadata;
+    // Vertex id of every possible airport code, indexed by PackedCode::Value() (kInvalidId if not in the graph)
+    ArenaVector<uint32_t> ids;
+    // Compressed sparse row adjacency: the outgoing edges of vertex u are the entries [offsets[u], offsets[u + 1]) of
+    // targets and arcs, in the order the routes appear in the routes file
+    ArenaVector<uint32_t> offsets;
+    // Destination ids only, for traversals that ignore weights. Empty if the adjacency is compressed
+    ArenaVector<uint32_t> targets;
+    // Destination ids with their weights, so weighted searches read one contiguous array per vertex
+    ArenaVector<Arc> arcs;
+    // Reverse adjacency in the same layout: the incoming edges of vertex v come from sources[in_offsets[v]] to
+    // sources[in_offsets[v + 1] - 1], ordered by source id. sources is empty if the adjacency is compressed
+    ArenaVector<uint32_t> in_offsets;
+    ArenaVector<uint32_t> sources;
+    // Whether targets and sources are replaced by their compressed form (GraphOptions::compressed_adjacency)
+    bool compressed = false;
+    VarintLists compressed_targets;
+    VarintLists compressed_sources;
+    // Optional bit matrix adjacency: bit v of row u (matrix_words 64 bit words per row) is set if there is an edge u->v
+    // Empty unless GraphOptions::adjacency_matrix was set
+    ArenaVector<uint64_t> matrix;
+    size_t matrix_words = 0;
+    // Gets the position of the edge from source to dest in targets/arcs, or kInvalidId if there is no such edge
+    uint32_t FindEdge(uint32_t source, uint32_t dest) const;
+    uint32_t GetId(PackedCode code) const;
+    // Adds a vertex or replaces the one with the same code, copying its strings into the metadata arena
+    void AddVertex(std::string_view key, std::string_view name, std::string_view city, std::string_view country, Coord coords);
+    // Builds the id-only lists (targets or compressed_targets) and the reverse adjacency from offsets and arcs
+    void BuildTraversalLists();
+    // Calls f(v) for every edge u->v, in adjacency order or in id order if the adjacency is compressed
+    // f may return true to stop early (see CallVisitor), in which case the function returns true
+    template <typename F>
+    bool ForEachTarget(uint32_t u, F f) const;
+    // Calls f(u) for every edge u->v, in id order. Stops early like ForEachTarget
+    template <typename F>
+    bool ForEachSource(uint32_t v, F f) const;
+    // Builds the vertex positions, and the optional indexes requested by options from the forward adjacency
+    void BuildIndexes(const GraphOptions& options);
+    // Great-circle distance between two vertices computed from their positions, scaled down very slightly so that
+    // rounding cannot make it exceed Distance() of the same coordinates
+    double GeodesicBound(uint32_t from, uint32_t to) const;
+    // Best-first search from source to target over the edge weights. Vertices are expanded in order of their distance
+    // from the source plus heuristic(v), an estimate of the rest of the route from v
+    template <typename Queue, typename Heuristic>
+    ShortestPath BestFirstSearch(uint32_t source, uint32_t target, SearchWorkspace& workspace, Heuristic heuristic) const;
+    // Computes new_id[old id] for a vertex order
+    std::vector<uint32_t> ComputeOrder(VertexOrder order) const;
+    // Renumbers every vertex u to new_id[u], keeping the order of each adjacency list
+    void Renumber(const std::vector<uint32_t>& new_id);
+    // Marks the destinations of both first and second in common, returns how many there are
+    unsigned CommonDestinations(uint32_t first, uint32_t second, std::vector<uint32_t>* out) const;
+    void BFS(uint32_t start, std::vector<std::string>& v, std::vector<bool>& visited) const;
+    friend class BFSTraversal;
+    // Breadth-first search restricted to the vertices v with component[v] == id, over outgoing edges or, if backward,
+    // incoming ones. Sets the levels of the component's vertices (others are left alone), returns the highest level
+    uint32_t ComponentBFS(uint32_t start, bool backward, const std::vector<uint32_t>& component, uint32_t id,
+                          std::vector<uint32_t>& levels) const;
+};
+
+template <typename F>
+bool Graph::ForEachTarget(uint32_t u, F f) const {
+  if (compressed) return compressed_targets.ForEach(u, offsets[u + 1] - offsets[u], f);
+  for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+    if (CallVisitor(f, targets[edge])) return true;
+  }
+  return false;
+}
+
+template <typename F>
+bool Graph::ForEachSource(uint32_t v, F f) const {
+  if (compressed) return compressed_sources.ForEach(v, in_offsets[v + 1] - in_offsets[v], f);
+  for (uint32_t edge = in_offsets[v]; edge < in_offsets[v + 1]; edge++) {
+    if (CallVisitor(f, sources[edge])) return true;
+  }
+  return false;
+}
+
+template <typename Queue, typename Heuristic>
+ShortestPath Graph::BestFirstSearch(uint32_t source, uint32_t target, SearchWorkspace& workspace,
+                                    Heuristic heuristic) const {
+  // reference: https://courses.grainger.illinois.edu/cs225/fa2020/resources/dijkstra/
+  ShortestPath result = {{}, std::numeric_limits<double>::max(), 0};
+  uint32_t n = vertices.size();
+  if (source >= n || target >= n) return result;
+  Queue& queue = workspace.Reset<Queue>(n);
+  workspace.Reach(source, 0, kInvalidId);
+  queue.Push(heuristic(source), source);
+  bool found = false;
+  while (!queue.Empty()) {
+    QueueEntry curr = queue.Pop();
+    // Queues with lazy deletion still hold the older entries of vertices whose distance was lowered
+    if (workspace.IsSettled(curr.id)) continue;
+    workspace.Settle(curr.id);
+    result.settled++;
+    if (curr.id == target) {
+      found = true;
+      break;
+    }
+    double curr_dist = workspace.Distance(curr.id);
+    const Arc* end_arc = arcs.data() + offsets[curr.id + 1];
+    for (const Arc* arc = arcs.data() + offsets[curr.id]; arc != end_arc; arc++) {
+      uint32_t neighbor = arc->target;
+      if (workspace.IsSettled(neighbor)) continue;
+      double new_dist = curr_dist + arc->weight;
+      if (new_dist < workspace.Distance(neighbor)) {
+        workspace.Reach(neighbor, new_dist, curr.id);
+        // With a consistent heuristic a key is never below the key just popped, except by rounding; with a weighted one
+        // it can be. Clamping it keeps every key at least the last one popped, as monotone queues (the radix heap) need
+        queue.Push(std::max(new_dist + heuristic(neighbor), curr.key), neighbor);
+      }
+    }
+  }
+  if (!found) return result;
+  // Reconstructing the path from previous
+  result.distance = workspace.Distance(target);
+  for (uint32_t curr = target; curr != kInvalidId; curr = workspace.Previous(curr)) {
+    result.vertices.push_back(curr);
+  }
+  std::reverse(result.vertices.begin(), result.vertices.end());
+  return result;
+}
+
+template <typename Queue>
+ShortestPath Graph::ShortestRoute(uint32_t source, uint32_t target, SearchWorkspace& workspace) const {
+  return BestFirstSearch<Queue>(source, target, workspace, [](uint32_t) {
+    return 0.0;
+  });
+}
+
+template <typename Queue>
+ShortestPath Graph::ShortestRoute(uint32_t source, uint32_t target) const {
+  return ShortestRoute<Queue>(source, target, SearchWorkspace::Local());
+}
+
+template <typename Queue>
+ShortestPath Graph::AStarRoute(uint32_t source, uint32_t target, double weight, SearchWorkspace& workspace) const {
+  if (!(weight >= 1)) {
+    throw std::invalid_argument("A* weight must be at least 1");
+  }
+  if (!geodesic_weights || source >= vertices.size() || target >= vertices.size()) {
+    return ShortestRoute<Queue>(source, target, workspace);
+  }
+  return BestFirstSearch<Queue>(source, target, workspace, [this, target, weight](uint32_t v) {
+    return weight * GeodesicBound(v, target);
+  });
+}
+
+inline double Graph::GeodesicBound(uint32_t from, uint32_t to) const {
+  // Angle between unit vectors a and b as 2 atan2(|a - b|, |a + b|), which stays accurate for nearby and for nearly
+  // antipodal points. The scale leaves room for rounding in both this and Distance()
+  const double kScale = 2 * 6371 * (1 - 1e-9);
+  const UnitVector& a = positions[from];
+  const UnitVector& b = positions[to];
+  double dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+  double sx = a.x + b.x, sy = a.y + b.y, sz = a.z + b.z;
+  return kScale * std::atan2(std::sqrt(dx * dx + dy * dy + dz * dz), std::sqrt(sx * sx + sy * sy + sz * sz));
+}
+
+inline std::string_view DestinationRange::Iterator::operator*() const {
+  return graph->GetCode(arc->target);
+}
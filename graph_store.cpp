@@ -0,0 +1,86 @@
+#include "graph_store.h"
+
+/**
+* Creates a store whose first version is graph
+* @param graph the initial graph
+*/
+GraphStore::GraphStore(Graph graph) : version(0) {
+  slots.push_back(std::make_unique<Slot>());
+  slots.back()->graph = std::make_shared<const Graph>(std::move(graph));
+  current.store(slots.back().get());
+}
+
+FrozenGraph GraphStore::Current() const {
+  while (true) {
+    Slot* slot = current.load();
+    slot->readers.fetch_add(1);
+    // Counted in, so the writer cannot empty or reuse the slot. If it is still current its handle is the latest one,
+    // otherwise an update happened in between and the new slot is loaded instead
+    if (current.load() == slot) {
+      FrozenGraph graph = slot->graph;
+      slot->readers.fetch_sub(1);
+      return graph;
+    }
+    slot->readers.fetch_sub(1);
+  }
+}
+
+uint64_t GraphStore::GetVersion() const {
+  return version.load(std::memory_order_acquire);
+}
+
+/**
+* Publishes a new version of the graph
+* @param change modifications to apply to the new version
+* @return the number of the published version
+*/
+uint64_t GraphStore::Update(const std::function<void(Graph&)>& change) {
+  std::lock_guard<std::mutex> lock(write_mutex);
+  Slot* previous = current.load();
+  // Readers keep using the old version until they release it; the copy is private until it is published
+  std::shared_ptr<Graph> next = std::make_shared<Graph>(*previous->graph);
+  change(*next);
+  Slot* slot = nullptr;
+  for (const auto& candidate : slots) {
+    if (candidate.get() != previous && candidate->readers.load() == 0) {
+      slot = candidate.get();
+      break;
+    }
+  }
+  if (slot == nullptr) {
+    slots.push_back(std::make_unique<Slot>());
+    slot = slots.back().get();
+  }
+  slot->graph = FrozenGraph(std::move(next));
+  current.store(slot);
+  // The store's reference to each older version is dropped once no reader is copying it; readers holding a handle keep
+  // their version alive. A slot still being copied from is emptied by a later update
+  for (const auto& old : slots) {
+    if (old.get() != slot && old->graph && old->readers.load() == 0) old->graph.reset();
+  }
+  return version.fetch_add(1, std::memory_order_release) + 1;
+}
+
+/**
+* Creates a reader holding the latest version of a store
+* @param store the store to read from, must outlive the reader
+*/
+GraphStore::Reader::Reader(const GraphStore& store) : store(&store), version(store.GetVersion()), graph(store.Current()) {}
+
+/**
+* Gets the latest version of the graph, refreshing the cached handle only if a new version was published
+* @return the graph, valid until the next call to Get() or until the reader is destroyed
+*/
+const Graph& GraphStore::Reader::Get() {
+  uint64_t latest = store->GetVersion();
+  if (latest != version) {
+    // The version number is read before the handle, so a version published in between is picked up next time
+    graph = store->Current();
+    version = latest;
+  }
+  return *graph;
+}
+
+uint64_t GraphStore::Reader::GetVersion() const {
+  return version;
+}
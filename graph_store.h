@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "graph.h"
+
+// Immutable version of a graph. Every query method of Graph is const, so any number of threads can use one at the same
+// time; the version stays alive as long as some reader holds a handle to it
+typedef std::shared_ptr<const Graph> FrozenGraph;
+
+// Publishes successive versions of a graph to concurrent readers (multi-version concurrency control). Writers apply
+// changes to a private copy of the latest version and publish it atomically, so readers never see a partial update
+class GraphStore {
+  public:
+    explicit GraphStore(Graph graph);
+    // Gets the latest version without locking (the standard atomic shared_ptr functions lock a mutex pool). Prefer a
+    // Reader on hot paths, which only touches the shared handle when it changes
+    FrozenGraph Current() const;
+    // Number of versions published since the store was created
+    uint64_t GetVersion() const;
+    // Copies the latest version, applies change to the copy (e.g. SetEdgeWeight, AddEdge, RemoveEdge) and publishes it
+    // Writers are serialized with each other but never wait for readers. Returns the new version number
+    uint64_t Update(const std::function<void(Graph&)>& change);
+
+    // Handle to the store owned by one reader thread. Get() costs a single atomic load while the store is unchanged,
+    // and never blocks or takes a lock; after an update it picks up the new version on the next call
+    class Reader {
+      public:
+        explicit Reader(const GraphStore& store);
+        const Graph& Get();
+        // Version number seen by the last call to Get(). The graph it returned is at least that new
+        uint64_t GetVersion() const;
+      private:
+        const GraphStore* store;
+        uint64_t version;
+        FrozenGraph graph;
+    };
+
+  private:
+    // Holder of one published version. Slots are reused instead of freed, so a reader that loaded a slot just before
+    // it was replaced can still safely count itself in and back off
+    struct Slot {
+      FrozenGraph graph;
+      // Readers between loading the slot and finishing a copy of its handle. The writer empties or reuses a replaced
+      // slot only while this is 0, and a reader only copies the handle after seeing the slot still current once counted
+      std::atomic<uint32_t> readers{0};
+    };
+    // Slot of the latest version
+    std::atomic<Slot*> current;
+    // Every slot, guarded by write_mutex
+    std::vector<std::unique_ptr<Slot>> slots;
+    // Incremented after each new version is stored in current
+    std::atomic<uint64_t> version;
+    std::mutex write_mutex;
+};
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+
+#include "graph.h"
+
+namespace {
+
+/**
+* Position of a point along a Hilbert curve filling a 65536 x 65536 grid
+* @param x column of the point
+* @param y row of the point
+* @return distance of the point along the curve
+*/
+uint64_t HilbertIndex(uint32_t x, uint32_t y) {
+  // reference: https://en.wikipedia.org/wiki/Hilbert_curve#Applications_and_mapping_algorithms
+  const uint32_t n = 1 << 16;
+  uint64_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += uint64_t(s) * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant so the curve stays continuous
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+// 32 KB, 8-way set associative cache with 64 byte lines and LRU replacement
+class CacheModel {
+  public:
+    CacheModel() : tags(kSets * kWays, UINT64_MAX), used(kSets * kWays, 0), clock(0), accesses(0), misses(0) {}
+    void Access(uint64_t address) {
+      uint64_t line = address / 64;
+      size_t set = (line % kSets) * kWays;
+      accesses++;
+      clock++;
+      size_t victim = set;
+      for (size_t way = set; way < set + kWays; way++) {
+        if (tags[way] == line) {
+          used[way] = clock;
+          return;
+        }
+        if (used[way] < used[victim]) victim = way;
+      }
+      misses++;
+      tags[victim] = line;
+      used[victim] = clock;
+    }
+    double MissRate() const {
+      return accesses == 0 ? 0 : double(misses) / accesses;
+    }
+  private:
+    static const size_t kSets = 64;
+    static const size_t kWays = 8;
+    std::vector<uint64_t> tags;
+    std::vector<uint64_t> used;
+    uint64_t clock;
+    uint64_t accesses;
+    uint64_t misses;
+};
+
+}  // namespace
+
+/**
+* Computes the ids the vertices would have in a given order
+* @param order the vertex order
+* @return new_id, where new_id[u] is the new id of the vertex that currently has id u
+*/
+std::vector<uint32_t> Graph::ComputeOrder(VertexOrder order) const {
+  uint32_t n = vertices.size();
+  std::vector<uint32_t> sequence(n);
+  for (uint32_t u = 0; u < n; u++) {
+    sequence[u] = u;
+  }
+  auto degree = [this](uint32_t u) {
+    return (offsets[u + 1] - offsets[u]) + (in_offsets[u + 1] - in_offsets[u]);
+  };
+
+  if (order == VertexOrder::kDegree) {
+    std::stable_sort(sequence.begin(), sequence.end(), [&](uint32_t a, uint32_t b) {
+      return degree(a) > degree(b);
+    });
+  } else if (order == VertexOrder::kHilbert) {
+    std::vector<uint64_t> position(n);
+    for (uint32_t u = 0; u < n; u++) {
+      double x = (vertices[u].coords.second + 180.0) / 360.0 * 65535.0;
+      double y = (vertices[u].coords.first + 90.0) / 180.0 * 65535.0;
+      position[u] = HilbertIndex(std::min(std::max(x, 0.0), 65535.0), std::min(std::max(y, 0.0), 65535.0));
+    }
+    std::stable_sort(sequence.begin(), sequence.end(), [&](uint32_t a, uint32_t b) {
+      return position[a] < position[b];
+    });
+  } else if (order == VertexOrder::kRCM) {
+    // Cuthill-McKee: each component is traversed breadth-first over both edge directions starting from its lowest
+    // degree vertex, visiting neighbors from lowest to highest degree. The result is then reversed
+    std::vector<uint32_t> starts = sequence;
+    std::stable_sort(starts.begin(), starts.end(), [&](uint32_t a, uint32_t b) {
+      return degree(a) < degree(b);
+    });
+    std::vector<bool> visited(n);
+    std::vector<uint32_t> neighbors;
+    sequence.clear();
+    for (uint32_t start : starts) {
+      if (visited[start]) continue;
+      std::queue<uint32_t> q;
+      q.push(start);
+      visited[start] = true;
+      while (!q.empty()) {
+        uint32_t curr = q.front();
+        q.pop();
+        sequence.push_back(curr);
+        neighbors.clear();
+        // Outgoing edges are read in file order, so the order does not depend on whether the adjacency is compressed
+        for (uint32_t edge = offsets[curr]; edge < offsets[curr + 1]; edge++) {
+          if (!visited[arcs[edge].target]) {
+            visited[arcs[edge].target] = true;
+            neighbors.push_back(arcs[edge].target);
+          }
+        }
+        ForEachSource(curr, [&](uint32_t source) {
+          if (!visited[source]) {
+            visited[source] = true;
+            neighbors.push_back(source);
+          }
+        });
+        std::stable_sort(neighbors.begin(), neighbors.end(), [&](uint32_t a, uint32_t b) {
+          return degree(a) < degree(b);
+        });
+        for (uint32_t neighbor : neighbors) {
+          q.push(neighbor);
+        }
+      }
+    }
+    std::reverse(sequence.begin(), sequence.end());
+  }
+
+  std::vector<uint32_t> new_id(n);
+  for (uint32_t i = 0; i < n; i++) {
+    new_id[sequence[i]] = i;
+  }
+  return new_id;
+}
+
+/**
+* Renumbers the vertices and rebuilds the adjacency indexes for the new ids
+* @param new_id the new id of each vertex, a permutation of the current ids
+*/
+void Graph::Renumber(const std::vector<uint32_t>& new_id) {
+  uint32_t n = vertices.size();
+  std::vector<uint32_t> old_id(n);
+  for (uint32_t u = 0; u < n; u++) {
+    old_id[new_id[u]] = u;
+  }
+  // The arrays are rewritten in place from temporary copies, so a graph built in an arena does not leave the old
+  // arrays behind in it
+  std::vector<VertexData> old_vertices(vertices.begin(), vertices.end());
+  std::vector<uint32_t> old_offsets(offsets.begin(), offsets.end());
+  std::vector<Arc> old_arcs(arcs.begin(), arcs.end());
+  uint32_t edge = 0;
+  for (uint32_t u = 0; u < n; u++) {
+    uint32_t old = old_id[u];
+    vertices[u] = old_vertices[old];
+    offsets[u] = edge;
+    // Each adjacency list keeps its order, so traversals visit airports in the same order as before
+    for (uint32_t old_edge = old_offsets[old]; old_edge < old_offsets[old + 1]; old_edge++, edge++) {
+      arcs[edge] = {new_id[old_arcs[old_edge].target], old_arcs[old_edge].weight};
+    }
+  }
+  offsets[n] = edge;
+  for (uint32_t& id : ids) {
+    if (id != kInvalidId) id = new_id[id];
+  }
+  BuildTraversalLists();
+}
+
+/**
+* Measures the memory locality of the current vertex numbering
+* @return locality statistics over all edges
+*/
+LocalityStats Graph::GetLocalityStats() const {
+  LocalityStats stats = {0, 0, 0};
+  if (arcs.empty()) return stats;
+  double span = 0;
+  size_t same_line = 0;
+  for (uint32_t u = 0; u < vertices.size(); u++) {
+    for (uint32_t edge = offsets[u]; edge < offsets[u + 1]; edge++) {
+      span += std::abs(int64_t(u) - int64_t(arcs[edge].target));
+      same_line += u / 8 == arcs[edge].target / 8;
+    }
+  }
+  // One pull-based PageRank iteration reads the 8 byte value of every incoming edge's source
+  CacheModel cache;
+  for (uint32_t v = 0; v < vertices.size(); v++) {
+    ForEachSource(v, [&](uint32_t source) {
+      cache.Access(uint64_t(source) * sizeof(double));
+    });
+  }
+  stats.mean_edge_span = span / arcs.size();
+  stats.same_line_fraction = double(same_line) / arcs.size();
+  stats.simulated_miss_rate = cache.MissRate();
+  return stats;
+}
@@ -1,37 +1,143 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <random>
+#include <thread>
+#include <stdexcept>
 
 #include "graph.h"
 
-int main() {
-  Graph g("data/airports.dat", "data/routes.dat");
+Graph LoadGraph(int argc, char* argv[]) {
+  GraphOptions options;
+  options.threads = std::thread::hardware_concurrency();
+  if (argc < 2) return Graph("data/airports.dat", "data/routes.dat", options);
+  // A snapshot path was given: load it, or build the graph from the dataset and save it there for next time
+  try {
+    return Graph::LoadSnapshot(argv[1]);
+  } catch (const std::runtime_error& e) {
+    std::cout << e.what() << ", rebuilding from dataset" << std::endl;
+  }
+  Graph g("data/airports.dat", "data/routes.dat", options);
+  // The snapshot is only a cache, so the demo carries on with the graph it built if it cannot be written
+  try {
+    g.SaveSnapshot(argv[1]);
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Warning: " << e.what() << std::endl;
+  }
+  return g;
+}
+
+int main(int argc, char* argv[]) {
+  Graph g = LoadGraph(argc, argv);
   std::string input;
   std::cout << "Welcome to our project demo!" << std::endl;
   std::cout << "Please enter a command. For a list of commands type `help`. Type `quit` to exit." << std::endl;
   while (true) {
     std::cout << "> ";
-    std::cin >> input;
+    // End of input quits, so a piped command list cannot repeat its last command forever
+    if (!(std::cin >> input)) return 0;
     if (input == "help") {
-      std::cout << "Commands: bfs, dijkstra, pagerank" << std::endl;
+      std::cout << "Commands: bfs, hops, reach, allhops, components, diameter, dijkstra, queues, astar, pagerank, layout, memory" << std::endl;
     } else if (input == "bfs") {
       std::cout << "(Optional) Please specify a starting airport or type NA" << std::endl;
       std::string start;
       std::cin >> start;
-      std::vector<std::string> traversal;
-      if (start == "NA") {
-        traversal = g.BFS();
-      } else {
+      if (start != "NA") {
         if (!g.VertexExists(start)) {
           std::cout << "Airport not recognized" << std::endl;
           continue;
         }
-        traversal = g.BFS(start);
+        // Only the first 25 airports of the traversal are computed
+        std::cout << "First 25 airports of a breadth-first search from " << start << ":" << std::endl;
+        BFSTraversal traversal = g.Traverse(start);
+        size_t count = 0;
+        for (auto it = traversal.begin(); it != traversal.end() && count < 25; ++it, count++) {
+          std::cout << (*it).GetKey() << " – " << (*it).GetName() << std::endl;
+        }
+        continue;
       }
+      std::vector<std::string> traversal = g.BFS();
       size_t size = traversal.size() < 25 ? traversal.size() : 25;
       std::cout << traversal.size() << " airports traversed with a breadth-first search. First 25:" << std::endl;
       for (size_t i = 0; i < size; i++) {
-        std::cout << traversal[i] << " – " << g.GetVertex(traversal[i]).GetName() << std::endl;
+        std::cout << traversal[i] << " – " << g.FindVertex(traversal[i]).GetName() << std::endl;
+      }
+    } else if (input == "hops") {
+      std::cout << "Please specify a starting airport" << std::endl;
+      std::string start;
+      std::cin >> start;
+      if (!g.VertexExists(start)) {
+        std::cout << "Airport not recognized" << std::endl;
+        continue;
+      }
+      BFSTree tree = g.BFSLevels(g.GetId(start));
+      uint64_t top_down_edges = g.BFSLevels(g.GetId(start), BFSStrategy::kTopDown).edges_examined;
+      std::vector<size_t> counts;
+      for (uint32_t level : tree.levels) {
+        if (level == BFSTree::kUnreached) continue;
+        if (level >= counts.size()) counts.resize(level + 1);
+        counts[level]++;
+      }
+      for (size_t level = 0; level < counts.size(); level++) {
+        std::cout << counts[level] << " airports " << level << " legs away" << std::endl;
+      }
+      std::cout << "Edges examined: " << tree.edges_examined << " direction-optimizing, " << top_down_edges << " top-down" << std::endl;
+    } else if (input == "reach") {
+      std::cout << "Please specify a starting airport and the most flights allowed, for example CMI 2" << std::endl;
+      std::string start;
+      long long max_legs;
+      if (!(std::cin >> start >> max_legs) || max_legs < 0) {
+        std::cout << "Usage: reach <airport> <flights>, with a flight count of 0 or more" << std::endl;
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        continue;
+      }
+      if (!g.VertexExists(start)) {
+        std::cout << "Airport not recognized" << std::endl;
+        continue;
+      }
+      std::vector<ReachedVertex> reached = g.ReachableWithin(start, std::min<long long>(max_legs, UINT32_MAX));
+      std::cout << reached.size() - 1 << " airports within " << max_legs << " flights. First 25:" << std::endl;
+      for (size_t i = 1; i < reached.size() && i <= 25; i++) {
+        std::cout << g.GetCode(reached[i].id) << " (" << reached[i].hops << " flights, via " << g.GetCode(reached[i].parent)
+                  << ") – " << g.GetName(reached[i].id) << std::endl;
+      }
+    } else if (input == "allhops") {
+      std::cout << "Computing hop counts between all pairs of airports..." << std::endl;
+      HopMatrix hops = g.AllPairsHops(std::thread::hardware_concurrency());
+      std::vector<uint64_t> counts = hops.CountPairsByHops();
+      uint64_t total = 0;
+      for (uint64_t count : counts) {
+        total += count;
       }
+      uint64_t cumulative = 0;
+      for (size_t hop = 1; hop < counts.size(); hop++) {
+        cumulative += counts[hop];
+        std::cout << std::setw(2) << hop << " legs: " << std::setw(9) << counts[hop] << " pairs, " << std::fixed
+                  << std::setprecision(1) << 100.0 * cumulative / total << "% of connected pairs within " << hop << " legs"
+                  << std::endl;
+      }
+    } else if (input == "components") {
+      const std::pair<const char*, Components> kinds[] = {{"Strongly", g.StronglyConnectedComponents()},
+                                                          {"Weakly", g.WeaklyConnectedComponents()}};
+      for (const auto& kind : kinds) {
+        std::vector<uint32_t> sizes = kind.second.sizes;
+        std::sort(sizes.begin(), sizes.end(), std::greater<>());
+        size_t singletons = std::count(sizes.begin(), sizes.end(), 1);
+        std::cout << kind.first << " connected components: " << sizes.size() << " (" << singletons << " single airports). Largest:";
+        for (size_t i = 0; i < sizes.size() && i < 5; i++) {
+          std::cout << " " << sizes[i];
+        }
+        std::cout << std::endl;
+      }
+    } else if (input == "diameter") {
+      EccentricityStats stats = g.Eccentricities(16, std::thread::hardware_concurrency());
+      std::cout << "Largest strongly connected component: diameter " << stats.diameter << " legs, radius between "
+                << stats.radius_lower << " and " << stats.radius_upper << " legs" << std::endl;
+      std::cout << "Breadth-first searches: " << stats.diameter_bfs_runs << " for the diameter, " << stats.sample_bfs_runs
+                << " for the eccentricity bounds" << std::endl;
     } else if (input == "dijkstra") {
       std::cout << "Provide 3 letter airport codes to find the shortest path between the two. For example, SFO (San Francisco) to CMI (Willard Airport)." << std::endl;
       std::string src, dest;
@@ -49,12 +155,95 @@ int main() {
       }
       const auto & path = g.Dijkstras(src, dest);
       std::cout << path.first << std::endl;
+    } else if (input == "queues") {
+      // The same random airport pairs are searched with every priority queue
+      const size_t kPairs = 500;
+      std::mt19937 rng(225);
+      std::uniform_int_distribution<uint32_t> pick(0, g.GetNumVertices() - 1);
+      std::vector<std::pair<uint32_t, uint32_t>> pairs(kPairs);
+      for (auto& pair : pairs) {
+        pair = std::make_pair(pick(rng), pick(rng));
+      }
+      std::cout << "Dijkstra's algorithm between " << kPairs << " random pairs of airports:" << std::endl;
+      const std::pair<const char*, QueuePolicy> policies[] = {{"binary", QueuePolicy::kBinaryHeap},
+                                                              {"4-ary", QueuePolicy::kQuaternaryHeap},
+                                                              {"pairing", QueuePolicy::kPairingHeap},
+                                                              {"radix", QueuePolicy::kRadixHeap}};
+      for (const auto& policy : policies) {
+        uint64_t settled = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (const auto& pair : pairs) {
+          settled += g.ShortestRoute(pair.first, pair.second, policy.second).settled;
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - begin;
+        std::cout << std::setw(8) << policy.first << ": " << std::fixed << std::setprecision(1) << elapsed.count() / kPairs
+                  << " us per search, " << settled / kPairs << " airports settled on average" << std::endl;
+      }
+    } else if (input == "astar") {
+      // Random pairs of airports with a route between them, searched with each heuristic weight
+      const size_t kPairs = 500;
+      std::mt19937 rng(225);
+      std::uniform_int_distribution<uint32_t> pick(0, g.GetNumVertices() - 1);
+      std::vector<std::pair<uint32_t, uint32_t>> pairs;
+      std::vector<double> shortest;
+      while (pairs.size() < kPairs) {
+        uint32_t source = pick(rng), target = pick(rng);
+        ShortestPath route = g.ShortestRoute(source, target);
+        if (route.vertices.empty()) continue;
+        pairs.push_back(std::make_pair(source, target));
+        shortest.push_back(route.distance);
+      }
+      std::cout << "Searches between " << kPairs << " random connected pairs of airports:" << std::endl;
+      const double weights[] = {0, 1, 1.2, 1.5, 2};
+      for (double weight : weights) {
+        uint64_t settled = 0;
+        double excess = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kPairs; i++) {
+          ShortestPath route = weight == 0 ? g.ShortestRoute(pairs[i].first, pairs[i].second)
+                                           : g.AStarRoute(pairs[i].first, pairs[i].second, weight);
+          settled += route.settled;
+          excess = std::max(excess, route.distance / shortest[i] - 1);
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - begin;
+        if (weight == 0) {
+          std::cout << "     Dijkstra";
+        } else {
+          std::cout << "A* weight " << std::fixed << std::setprecision(1) << weight;
+        }
+        std::cout << ": " << std::fixed << std::setprecision(1) << elapsed.count() / kPairs << " us per search, "
+                  << settled / kPairs << " airports settled on average, routes at most " << 100 * excess
+                  << "% longer than shortest" << std::endl;
+      }
     } else if (input == "pagerank") {
       std::cout << "Running PageRank algorithm..." << std::endl;
       const auto & rank = g.PageRank();
       std::cout << "Top airports based on PageRank score:" << std::endl;
       for (size_t i = 0; i < 10; i++) {
-        std::cout << rank.second[i].second << " (" << std::fixed << std::setprecision(5) << rank.second[i].first << ") – " << g.GetVertex(rank.second[i].second).GetName() << std::endl;
+        std::cout << rank.second[i].second << " (" << std::fixed << std::setprecision(5) << rank.second[i].first << ") – " << g.FindVertex(rank.second[i].second).GetName() << std::endl;
+      }
+    } else if (input == "layout") {
+      std::cout << "Memory locality of each vertex order (lower span and miss rate are better):" << std::endl;
+      const std::pair<const char*, VertexOrder> orders[] = {{"file", VertexOrder::kFile}, {"rcm", VertexOrder::kRCM},
+                                                            {"degree", VertexOrder::kDegree}, {"hilbert", VertexOrder::kHilbert}};
+      for (const auto& order : orders) {
+        GraphOptions layout_options;
+        layout_options.order = order.second;
+        Graph reordered("data/airports.dat", "data/routes.dat", layout_options);
+        LocalityStats stats = reordered.GetLocalityStats();
+        std::cout << std::setw(8) << order.first << ": mean edge span " << std::fixed << std::setprecision(1) << stats.mean_edge_span
+                  << ", same cache line " << std::setprecision(3) << stats.same_line_fraction
+                  << ", simulated miss rate " << stats.simulated_miss_rate << std::endl;
+      }
+    } else if (input == "memory") {
+      MemoryBreakdown usage = g.MemoryUsage();
+      const std::pair<const char*, size_t> parts[] = {{"Vertex metadata", usage.vertex_metadata}, {"Edge records", usage.edge_records},
+                                                      {"Adjacency", usage.adjacency}, {"Reverse adjacency", usage.reverse_adjacency},
+                                                      {"Code index", usage.code_index}, {"Auxiliary indexes", usage.auxiliary_indexes},
+                                                      {"Arena slack", usage.arena_slack},
+                                                      {"Total", usage.Total()}};
+      for (const auto& part : parts) {
+        std::cout << std::setw(18) << part.first << ": " << std::fixed << std::setprecision(1) << part.second / 1024.0 << " KB" << std::endl;
       }
     } else if (input == "quit") {
       return 0;
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Priority queue policies for shortest path searches. Every policy has the same interface:
+//   Reset(num_vertices)  empties the queue for a search over ids in [0, num_vertices)
+//   Push(key, id)        sets the key of id, which is lower than any key it was pushed with before
+//   Empty()              whether no entries are left
+//   Pop()                removes and returns an entry with the lowest key
+// Queues with lazy deletion never look for an existing entry on Push, so Pop can return an id again with an older,
+// higher key. Searches skip such stale entries (vertices that are already settled)
+
+// An entry of a priority queue
+struct QueueEntry {
+  double key;
+  uint32_t id;
+};
+
+// Heap with D children per node over a flat array, with lazy deletion. Wider nodes make the heap shallower, so pushes
+// (the common operation in a sparse graph search) move through fewer levels and sifts touch fewer cache lines
+template <unsigned D>
+class DaryHeapQueue {
+  public:
+    void Reset(uint32_t) {
+      heap.clear();
+    }
+    void Push(double key, uint32_t id) {
+      size_t i = heap.size();
+      heap.push_back({key, id});
+      // Sift up, moving parents down into the hole instead of swapping
+      while (i > 0) {
+        size_t parent = (i - 1) / D;
+        if (heap[parent].key <= key) break;
+        heap[i] = heap[parent];
+        i = parent;
+      }
+      heap[i] = {key, id};
+    }
+    bool Empty() const {
+      return heap.empty();
+    }
+    QueueEntry Pop() {
+      QueueEntry top = heap.front();
+      QueueEntry last = heap.back();
+      heap.pop_back();
+      if (heap.empty()) return top;
+      size_t i = 0;
+      while (true) {
+        size_t first = i * D + 1;
+        if (first >= heap.size()) break;
+        size_t smallest = first;
+        size_t end = std::min(first + D, heap.size());
+        for (size_t child = first + 1; child < end; child++) {
+          if (heap[child].key < heap[smallest].key) smallest = child;
+        }
+        if (last.key <= heap[smallest].key) break;
+        heap[i] = heap[smallest];
+        i = smallest;
+      }
+      heap[i] = last;
+      return top;
+    }
+  private:
+    std::vector<QueueEntry> heap;
+};
+
+// Binary heap with lazy deletion
+typedef DaryHeapQueue<2> BinaryHeapQueue;
+// 4-ary heap with lazy deletion
+typedef DaryHeapQueue<4> QuaternaryHeapQueue;
+
+// Pairing heap with a real decrease-key, so it never holds more than one entry per vertex. Nodes live in a pool that
+// is reused between searches, and only the vertices pushed during a search are reset afterwards
+class PairingHeapQueue {
+  public:
+    PairingHeapQueue() : root(kNone) {}
+    void Reset(uint32_t num_vertices) {
+      for (uint32_t id : touched) {
+        handles[id] = kNone;
+      }
+      touched.clear();
+      if (handles.size() < num_vertices) handles.resize(num_vertices, kNone);
+      nodes.clear();
+      root = kNone;
+    }
+    void Push(double key, uint32_t id) {
+      uint32_t node = handles[id];
+      if (node == kNone) {
+        node = nodes.size();
+        nodes.push_back({key, id, kNone, kNone, kNone});
+        handles[id] = node;
+        touched.push_back(id);
+        root = Meld(root, node);
+        return;
+      }
+      nodes[node].key = key;
+      if (node == root) return;
+      // Cut the subtree out of its sibling list and meld it back in at the root
+      Node& n = nodes[node];
+      if (nodes[n.prev].child == node) {
+        nodes[n.prev].child = n.sibling;
+      } else {
+        nodes[n.prev].sibling = n.sibling;
+      }
+      if (n.sibling != kNone) nodes[n.sibling].prev = n.prev;
+      n.sibling = kNone;
+      n.prev = kNone;
+      root = Meld(root, node);
+    }
+    bool Empty() const {
+      return root == kNone;
+    }
+    QueueEntry Pop() {
+      const Node& top = nodes[root];
+      QueueEntry entry = {top.key, top.id};
+      // Popped vertices keep their handle so that Reset clears it, but it no longer refers to a node in the heap
+      handles[top.id] = kPopped;
+      root = MergePairs(top.child);
+      return entry;
+    }
+  private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr uint32_t kPopped = UINT32_MAX - 1;
+    struct Node {
+      double key;
+      uint32_t id;
+      uint32_t child;
+      uint32_t sibling;
+      // Parent if this is the first child, otherwise the previous sibling
+      uint32_t prev;
+    };
+    // Makes the root with the larger key the first child of the other one
+    uint32_t Meld(uint32_t a, uint32_t b) {
+      if (a == kNone) return b;
+      if (b == kNone) return a;
+      if (nodes[b].key < nodes[a].key) std::swap(a, b);
+      nodes[b].prev = a;
+      nodes[b].sibling = nodes[a].child;
+      if (nodes[a].child != kNone) nodes[nodes[a].child].prev = b;
+      nodes[a].child = b;
+      nodes[a].sibling = kNone;
+      nodes[a].prev = kNone;
+      return a;
+    }
+    // Two-pass merge of a list of siblings: meld pairs left to right, then the pairs right to left
+    uint32_t MergePairs(uint32_t first) {
+      pairs.clear();
+      while (first != kNone) {
+        uint32_t second = nodes[first].sibling;
+        uint32_t next = second == kNone ? kNone : nodes[second].sibling;
+        nodes[first].sibling = kNone;
+        nodes[first].prev = kNone;
+        if (second != kNone) {
+          nodes[second].sibling = kNone;
+          nodes[second].prev = kNone;
+        }
+        pairs.push_back(Meld(first, second));
+        first = next;
+      }
+      uint32_t merged = kNone;
+      for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+        merged = Meld(merged, *it);
+      }
+      return merged;
+    }
+    std::vector<Node> nodes;
+    // Node of each vertex id, kNone if it was not pushed in this search
+    std::vector<uint32_t> handles;
+    std::vector<uint32_t> touched;
+    std::vector<uint32_t> pairs;
+    uint32_t root;
+};
+
+// Radix heap (Ahuja et al., 1990) with lazy deletion. It is a monotone queue: keys pushed must not be lower than the
+// last key popped, which holds for Dijkstra's algorithm with non-negative weights. Non-negative doubles order the
+// same way as their bit patterns, so entries are bucketed by the highest bit in which their key differs from the last
+// key popped, and each entry moves to a lower bucket at most 64 times
+class RadixHeapQueue {
+  public:
+    RadixHeapQueue() : last(0), size(0) {}
+    void Reset(uint32_t) {
+      for (auto& bucket : buckets) {
+        bucket.clear();
+      }
+      last = 0;
+      size = 0;
+    }
+    void Push(double key, uint32_t id) {
+      buckets[Bucket(Bits(key))].push_back({key, id});
+      size++;
+    }
+    bool Empty() const {
+      return size == 0;
+    }
+    QueueEntry Pop() {
+      if (buckets[0].empty()) {
+        // The lowest non-empty bucket holds the minimum. It becomes the new reference, and the rest of that bucket
+        // spreads over the buckets below
+        size_t i = 1;
+        while (buckets[i].empty()) {
+          i++;
+        }
+        uint64_t minimum = UINT64_MAX;
+        for (const QueueEntry& entry : buckets[i]) {
+          minimum = std::min(minimum, Bits(entry.key));
+        }
+        last = minimum;
+        for (const QueueEntry& entry : buckets[i]) {
+          buckets[Bucket(Bits(entry.key))].push_back(entry);
+        }
+        buckets[i].clear();
+      }
+      QueueEntry entry = buckets[0].back();
+      buckets[0].pop_back();
+      size--;
+      return entry;
+    }
+  private:
+    static uint64_t Bits(double key) {
+      uint64_t bits;
+      memcpy(&bits, &key, sizeof(bits));
+      return bits;
+    }
+    size_t Bucket(uint64_t bits) const {
+      return bits == last ? 0 : 64 - __builtin_clzll(bits ^ last);
+    }
+    std::vector<QueueEntry> buckets[65];
+    uint64_t last;
+    size_t size;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "priority_queues.h"
+
+// State of a shortest path search, kept between searches so that a query does not allocate or clear arrays the size
+// of the graph. Each vertex label is stamped with the generation of the search that last wrote it, and labels from
+// older searches read as unreached, so starting a search only bumps the generation and a search costs in proportion to
+// the vertices it touches. Not thread-safe: every thread borrows its own with Local()
+class SearchWorkspace {
+  public:
+    SearchWorkspace() : generation(0) {}
+    SearchWorkspace(const SearchWorkspace&) = delete;
+    SearchWorkspace& operator=(const SearchWorkspace&) = delete;
+
+    // Workspace of the calling thread, created on first use and grown to the largest graph it has searched
+    static SearchWorkspace& Local() {
+      thread_local SearchWorkspace workspace;
+      return workspace;
+    }
+
+    // Starts a new search over ids in [0, num_vertices): every vertex becomes unreached and queue is emptied
+    template <typename Queue>
+    Queue& Reset(uint32_t num_vertices) {
+      if (labels.size() < num_vertices) labels.resize(num_vertices, {0, 0, 0});
+      // Reached and settled vertices are stamped generation and generation + 1
+      generation += 2;
+      if (generation >= std::numeric_limits<uint32_t>::max() - 1) {
+        // Once every 2^31 searches the stamps are cleared so old ones cannot match the restarted generation
+        for (Label& label : labels) {
+          label.stamp = 0;
+        }
+        generation = 2;
+      }
+      Queue& queue = std::get<Queue>(queues);
+      queue.Reset(num_vertices);
+      return queue;
+    }
+    // Shortest distance found so far to a vertex, infinite (std::numeric_limits<double>::max()) if it is unreached
+    double Distance(uint32_t id) const {
+      return labels[id].stamp >= generation ? labels[id].distance : std::numeric_limits<double>::max();
+    }
+    // Vertex before id on the route found so far. Only meaningful for reached vertices
+    uint32_t Previous(uint32_t id) const {
+      return labels[id].previous;
+    }
+    bool IsSettled(uint32_t id) const {
+      return labels[id].stamp == generation + 1;
+    }
+    // Records a shorter route to a vertex that is not settled
+    void Reach(uint32_t id, double distance, uint32_t previous) {
+      labels[id] = {distance, previous, generation};
+    }
+    void Settle(uint32_t id) {
+      labels[id].stamp = generation + 1;
+    }
+  private:
+    struct Label {
+      double distance;
+      uint32_t previous;
+      uint32_t stamp;
+    };
+    std::vector<Label> labels;
+    uint32_t generation;
+    // One of each policy in priority_queues.h, so their buffers are reused too
+    std::tuple<BinaryHeapQueue, QuaternaryHeapQueue, PairingHeapQueue, RadixHeapQueue> queues;
+};
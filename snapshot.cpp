@@ -0,0 +1,224 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "graph.h"
+
+/* Snapshot file layout (native byte order, every section starts at a multiple of 8 bytes):
+SnapshotHeader
+VertexRecord[num_vertices]  - vertices in index order
+uint32_t[num_vertices + 1]  - offsets of each vertex's outgoing edges (compressed sparse row)
+uint32_t[num_edges]         - destination vertex index of each edge, in adjacency order
+double[num_edges]           - weight of each edge
+char[strings_size]          - metadata arena holding the airport names and cities referenced by the vertex records
+The checksum covers everything after the header.
+*/
+
+namespace {
+
+const char kSnapshotMagic[4] = {'A', 'G', 'S', 'N'};
+const uint32_t kSnapshotVersion = 1;
+// Written in native byte order, reads back differently on a machine with the other endianness
+const uint32_t kByteOrderMark = 0x01020304;
+
+struct SnapshotHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t num_vertices;
+  uint32_t num_edges;
+  uint32_t reserved;
+  uint64_t strings_size;
+  uint64_t checksum;
+};
+static_assert(sizeof(SnapshotHeader) == 40, "snapshot header must not contain padding");
+
+struct VertexRecord {
+  // 3 letter airport code, null terminated
+  char key[4];
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t city_offset;
+  uint32_t city_length;
+  uint32_t reserved;
+  double latitude;
+  double longitude;
+};
+static_assert(sizeof(VertexRecord) == 40, "vertex record must not contain padding");
+
+size_t Align8(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+/**
+* Checksums a buffer a word at a time (FNV-1a over 64 bit words), fast enough to verify on every load
+* @param data start of the buffer
+* @param size length of the buffer in bytes
+* @return the checksum
+*/
+uint64_t Checksum(const char* data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  const uint64_t prime = 1099511628211ull;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+  }
+  return hash;
+}
+
+// Byte offsets of each section from the start of the payload
+struct SnapshotLayout {
+  size_t vertices;
+  size_t offsets;
+  size_t targets;
+  size_t weights;
+  size_t strings;
+  size_t size;
+};
+
+SnapshotLayout ComputeLayout(uint64_t num_vertices, uint64_t num_edges, uint64_t strings_size) {
+  SnapshotLayout layout;
+  layout.vertices = 0;
+  layout.offsets = layout.vertices + num_vertices * sizeof(VertexRecord);
+  layout.targets = Align8(layout.offsets + (num_vertices + 1) * sizeof(uint32_t));
+  layout.weights = Align8(layout.targets + num_edges * sizeof(uint32_t));
+  layout.strings = layout.weights + num_edges * sizeof(double);
+  layout.size = layout.strings + strings_size;
+  return layout;
+}
+
+}  // namespace
+
+/**
+* Saves the graph to a binary snapshot file
+* @param path the file to write
+*/
+void Graph::SaveSnapshot(const std::string& path) const {
+  SnapshotHeader header;
+  memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.byte_order = kByteOrderMark;
+  header.num_vertices = vertices.size();
+  header.num_edges = arcs.size();
+  header.reserved = 0;
+  header.strings_size = metadata.size();
+  SnapshotLayout layout = ComputeLayout(header.num_vertices, header.num_edges, header.strings_size);
+  std::vector<char> payload(layout.size, 0);
+
+  // The metadata arena is stored as is, so vertex records keep their offsets into it
+  for (uint32_t i = 0; i < vertices.size(); i++) {
+    const VertexData& vertex = vertices[i];
+    VertexRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.key, vertex.key, 3);
+    record.name_offset = vertex.name_offset;
+    record.name_length = vertex.name_length;
+    record.city_offset = vertex.city_offset;
+    record.city_length = vertex.city_length;
+    record.latitude = vertex.coords.first;
+    record.longitude = vertex.coords.second;
+    memcpy(&payload[layout.vertices + i * sizeof(VertexRecord)], &record, sizeof(record));
+  }
+  // The offsets array is stored exactly as it is laid out in memory
+  memcpy(&payload[layout.offsets], offsets.data(), offsets.size() * sizeof(uint32_t));
+  for (size_t i = 0; i < arcs.size(); i++) {
+    memcpy(&payload[layout.targets + i * sizeof(uint32_t)], &arcs[i].target, sizeof(uint32_t));
+    memcpy(&payload[layout.weights + i * sizeof(double)], &arcs[i].weight, sizeof(double));
+  }
+  memcpy(&payload[layout.strings], metadata.data(), metadata.size());
+  header.checksum = Checksum(payload.data(), payload.size());
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(payload.data(), payload.size());
+  if (!out) {
+    throw std::runtime_error("Could not write snapshot " + path);
+  }
+}
+
+/**
+* Loads a graph from a binary snapshot file
+* @param path the file to read
+* @param options vertex order, arena and optional indexes to build (the thread count is unused)
+* @return the graph stored in the snapshot
+*/
+Graph Graph::LoadSnapshot(const std::string& path, const GraphOptions& options) {
+  MappedFile file(path);
+  std::string_view contents = file.Contents();
+  SnapshotHeader header;
+  if (contents.size() < sizeof(header)) {
+    throw std::runtime_error("Missing or truncated snapshot " + path);
+  }
+  memcpy(&header, contents.data(), sizeof(header));
+  if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("Not a graph snapshot " + path);
+  }
+  if (header.version != kSnapshotVersion || header.byte_order != kByteOrderMark) {
+    throw std::runtime_error("Incompatible snapshot version or byte order " + path);
+  }
+  SnapshotLayout layout = ComputeLayout(header.num_vertices, header.num_edges, header.strings_size);
+  const char* payload = contents.data() + sizeof(header);
+  if (contents.size() - sizeof(header) != layout.size || Checksum(payload, layout.size) != header.checksum) {
+    throw std::runtime_error("Corrupted snapshot " + path);
+  }
+
+  Graph g;
+  g.UseArena(options.arena_block_size);
+  g.compressed = options.compressed_adjacency;
+  g.offsets.resize(header.num_vertices + 1);
+  g.arcs.resize(header.num_edges);
+  memcpy(g.offsets.data(), payload + layout.offsets, g.offsets.size() * sizeof(uint32_t));
+  for (uint32_t i = 0; i < header.num_edges; i++) {
+    memcpy(&g.arcs[i].target, payload + layout.targets + i * sizeof(uint32_t), sizeof(uint32_t));
+    memcpy(&g.arcs[i].weight, payload + layout.weights + i * sizeof(double), sizeof(double));
+  }
+  // A checksum collision must not be able to send the traversals out of bounds
+  bool valid = g.offsets.front() == 0 && g.offsets.back() == header.num_edges;
+  for (uint32_t i = 0; valid && i < header.num_vertices; i++) {
+    valid = g.offsets[i] <= g.offsets[i + 1];
+  }
+  for (uint32_t i = 0; valid && i < header.num_edges; i++) {
+    valid = g.arcs[i].target < header.num_vertices;
+  }
+  if (!valid) {
+    throw std::runtime_error("Corrupted snapshot " + path);
+  }
+
+  g.metadata.assign(payload + layout.strings, header.strings_size);
+  g.vertices.resize(header.num_vertices);
+  g.ids.assign(PackedCode::kNumCodes, kInvalidId);
+  for (uint32_t i = 0; i < header.num_vertices; i++) {
+    VertexRecord record;
+    memcpy(&record, payload + layout.vertices + i * sizeof(VertexRecord), sizeof(record));
+    if (uint64_t(record.city_offset) + record.city_length > header.strings_size ||
+        uint64_t(record.name_offset) + record.name_length > header.strings_size) {
+      throw std::runtime_error("Corrupted snapshot " + path);
+    }
+    PackedCode code(std::string_view(record.key, 3));
+    if (!code.IsValid() || g.ids[code.Value()] != kInvalidId) {
+      throw std::runtime_error("Corrupted snapshot " + path);
+    }
+    g.ids[code.Value()] = i;
+    VertexData& vertex = g.vertices[i];
+    memcpy(vertex.key, record.key, 3);
+    vertex.key[3] = '\0';
+    vertex.name_offset = record.name_offset;
+    vertex.name_length = record.name_length;
+    vertex.city_offset = record.city_offset;
+    vertex.city_length = record.city_length;
+    vertex.coords = Coord(record.latitude, record.longitude);
+  }
+  // The traversal lists, reverse adjacency and optional indexes are cheap to rebuild, so they are not stored
+  g.BuildTraversalLists();
+  if (options.order != VertexOrder::kFile) {
+    g.Renumber(g.ComputeOrder(options.order));
+  }
+  g.BuildIndexes(options);
+  return g;
+}
@@ -5,8 +5,14 @@
 #include <iomanip>
 #include <algorithm>
 #include <limits>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "../graph.h"
+#include "../graph_store.h"
 #include "../utils.h"
 
 /* Test data:
@@ -41,6 +47,323 @@ TEST_CASE("Parsing a small graph", "[graph]") {
   REQUIRE(neighbors[1] == "LAX");
 }
 
+TEST_CASE("Parsing vertices and edges in place", "[vertex][graph]") {
+  Vertex v;
+  REQUIRE(Vertex::Parse("3830,\"Chicago O'Hare International Airport\",\"Chicago\",\"United States\",\"ORD\",\"KORD\",41.9786,-87.9048,672", v));
+  REQUIRE(v.GetKey() == "ORD");
+  REQUIRE(v.GetName() == "Chicago O'Hare International Airport");
+  REQUIRE(v.GetCity() == "Chicago, United States");
+  REQUIRE(v.GetCoords().first == Approx(41.9786));
+  // Extra comma in the name shifts the coordinates, null IATA code, truncated line
+  REQUIRE(!Vertex::Parse("4351,\"Oslo, Fornebu Airport\",\"Oslo\",\"Norway\",\"FBU\",\"ENFB\",59.89,10.61", v));
+  REQUIRE(!Vertex::Parse("3883,\"Mc Minnville Municipal Airport\",\"Mackminnville\",\"United States\",\\N,\"KMMV\",45.19,-123.13", v));
+  REQUIRE(!Vertex::Parse("3830,\"Chicago O'Hare International Airport\"", v));
+  REQUIRE_THROWS_AS(Vertex(""), std::invalid_argument);
+
+  Edge e("AA,24,ORD,3830,LAX,3484,,0,738");
+  REQUIRE(e.GetKey() == "ORD-LAX");
+  REQUIRE_THROWS_AS(Edge("AA,24,ORD"), std::invalid_argument);
+}
+
+TEST_CASE("Dense vertex ids", "[graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  // Ids follow the order of the airport file
+  REQUIRE(g.GetId("ATL") == 0);
+  REQUIRE(g.GetId("LAX") == 1);
+  REQUIRE(g.GetId("LGA") == Graph::kInvalidId);
+  for (uint32_t id = 0; id < g.GetNumVertices(); id++) {
+    REQUIRE(g.GetId(g.GetCode(id)) == id);
+  }
+  REQUIRE(g.BFS("LGA").empty());
+  REQUIRE(g.Dijkstras("ORD", "LGA").first == "No path found");
+}
+
+TEST_CASE("Packed airport codes", "[utils][graph]") {
+  PackedCode ord("ORD");
+  REQUIRE(ord.IsValid());
+  REQUIRE(ord.ToString() == "ORD");
+  REQUIRE(PackedCode("DU9").ToString() == "DU9");
+  REQUIRE(PackedCode("AAA").Value() == 0);
+  REQUIRE(PackedCode("999").Value() == PackedCode::kNumCodes - 1);
+  REQUIRE(!PackedCode("ord").IsValid());
+  REQUIRE(!PackedCode("OR").IsValid());
+  REQUIRE(!PackedCode("ORDX").IsValid());
+  REQUIRE(!PackedCode("\\N").IsValid());
+  REQUIRE(!PackedCode().IsValid());
+
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  REQUIRE(g.VertexExists("ORD"));
+  REQUIRE(!g.VertexExists("ord"));
+  REQUIRE(!g.VertexExists("ORDX"));
+  REQUIRE(!g.EdgeExists("ORD", "lax"));
+  REQUIRE(g.GetDestinations("").empty());
+}
+
+TEST_CASE("Vertex metadata views", "[vertex][graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  VertexView ord = g.FindVertex("ORD");
+  REQUIRE(ord.IsValid());
+  REQUIRE(ord.GetKey() == "ORD");
+  REQUIRE(ord.GetName() == "Chicago O'Hare International Airport");
+  REQUIRE(ord.GetCity() == "Chicago, United States");
+  REQUIRE(ord.GetCoords() == g.GetCoords(ord.GetId()));
+  REQUIRE(g.GetName(g.GetId("LAX")) == "Los Angeles International Airport");
+  // Looking up a missing airport doesn't add it to the graph
+  REQUIRE(!g.FindVertex("LGA").IsValid());
+  REQUIRE(g.GetVertex("LGA").GetKey().empty());
+  REQUIRE(g.GetNumVertices() == 10);
+  REQUIRE(!g.VertexExists("LGA"));
+  REQUIRE(g.GetVertex("ORD").GetCity() == "Chicago, United States");
+}
+
+TEST_CASE("Non-copying neighbor access", "[graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  DestinationRange range = g.Destinations("ORD");
+  REQUIRE(range.size() == 2);
+  REQUIRE(std::vector<std::string>(range.begin(), range.end()) == g.GetDestinations("ORD"));
+  REQUIRE(std::find(range.begin(), range.end(), "SEA") == range.end());
+  REQUIRE(g.Destinations("XXX").empty());
+  REQUIRE(g.Destinations("XXX").begin() == g.Destinations("XXX").end());
+
+  Span<const Arc> arcs = g.GetArcs(g.GetId("ORD"));
+  REQUIRE(arcs.size() == range.size());
+  size_t i = 0;
+  for (std::string_view code : range) {
+    REQUIRE(g.GetCode(arcs[i].target) == code);
+    REQUIRE(arcs[i].weight == Distance(g.GetCoords(g.GetId("ORD")), g.GetCoords(arcs[i].target)));
+    i++;
+  }
+}
+
+TEST_CASE("Incoming edges", "[graph]") {
+  Graph g("tests/airports_small.dat", "tests/routes_small.dat");
+  std::vector<std::string> origins = g.GetOrigins("ATL");
+  std::sort(origins.begin(), origins.end());
+  REQUIRE(origins == std::vector<std::string>{"CLT", "LAX"});
+  REQUIRE(g.GetOrigins("ORD").empty());
+  REQUIRE(g.GetOrigins("JFK").empty());
+  REQUIRE(g.GetOrigins("LGA").empty());
+  // Every outgoing edge shows up as an incoming edge of its destination
+  Graph sample("tests/sample_airports.dat", "tests/sample_routes.dat");
+  size_t incoming = 0;
+  for (const std::string& code : sample.BFS()) {
+    for (const std::string& origin : sample.GetOrigins(code)) {
+      REQUIRE(sample.EdgeExists(origin, code));
+      incoming++;
+    }
+  }
+  REQUIRE(incoming == sample.GetNumEdges());
+}
+
+TEST_CASE("Bit matrix adjacency", "[graph]") {
+  GraphOptions options;
+  options.adjacency_matrix = true;
+  Graph matrix("tests/sample_airports.dat", "tests/sample_routes.dat", options);
+  Graph lists("tests/sample_airports.dat", "tests/sample_routes.dat");
+  // Both representations agree on every vertex pair
+  for (uint32_t u = 0; u < lists.GetNumVertices(); u++) {
+    for (uint32_t v = 0; v < lists.GetNumVertices(); v++) {
+      REQUIRE(matrix.EdgeExists(u, v) == lists.EdgeExists(u, v));
+    }
+  }
+  REQUIRE(matrix.EdgeExists("ORD", "LAX"));
+  REQUIRE(!matrix.EdgeExists("ORD", "CLT"));
+  REQUIRE(!matrix.EdgeExists("ORD", "LGA"));
+  // CLT and LAX both fly to ATL
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat", options);
+  REQUIRE(small.GetCommonDestinations("CLT", "LAX") == std::vector<std::string>{"ATL"});
+  REQUIRE(small.CountCommonDestinations("CLT", "LAX") == 1);
+  REQUIRE(small.CountCommonDestinations("ORD", "LAX") == 0);
+  Graph small_lists("tests/airports_small.dat", "tests/routes_small.dat");
+  REQUIRE(small_lists.GetCommonDestinations("CLT", "LAX") == std::vector<std::string>{"ATL"});
+  REQUIRE(small_lists.CountCommonDestinations("JFK", "LAX") == 0);
+}
+
+TEST_CASE("Varint encoded lists", "[graph]") {
+  // A long run of one byte gaps, gaps needing several bytes, a single id and an empty list
+  std::vector<uint32_t> values;
+  for (uint32_t id = 40; id > 0; id--) {
+    values.push_back(id);
+  }
+  std::vector<uint32_t> sparse = {0, 127, 128, 16511, 2097279, UINT32_MAX, 1000, 1001};
+  values.insert(values.end(), sparse.begin(), sparse.end());
+  values.push_back(7);
+  uint32_t offsets[] = {0, 40, 48, 49, 49};
+  VarintLists lists;
+  lists.Assign(offsets, 4, values.data());
+  std::vector<uint32_t> decoded;
+  for (uint32_t list = 0; list < 4; list++) {
+    std::vector<uint32_t> expected(values.begin() + offsets[list], values.begin() + offsets[list + 1]);
+    std::sort(expected.begin(), expected.end());
+    decoded.clear();
+    lists.ForEach(list, offsets[list + 1] - offsets[list], [&](uint32_t id) {
+      decoded.push_back(id);
+    });
+    REQUIRE(decoded == expected);
+  }
+}
+
+TEST_CASE("Compressed adjacency", "[graph]") {
+  GraphOptions options;
+  options.compressed_adjacency = true;
+  Graph plain("data/airports.dat", "data/routes.dat");
+  Graph compressed("data/airports.dat", "data/routes.dat", options);
+  REQUIRE(compressed.GetNumEdges() == plain.GetNumEdges());
+  MemoryBreakdown plain_usage = plain.MemoryUsage();
+  MemoryBreakdown compressed_usage = compressed.MemoryUsage();
+  REQUIRE(compressed_usage.adjacency + compressed_usage.reverse_adjacency <
+          (plain_usage.adjacency + plain_usage.reverse_adjacency) * 3 / 4);
+  // Incoming lists are in id order either way, so PageRank sums in the same order
+  REQUIRE(compressed.PageRank().second == plain.PageRank().second);
+  REQUIRE(compressed.GetOrigins("ORD") == plain.GetOrigins("ORD"));
+  REQUIRE(compressed.GetDestinations("ORD") == plain.GetDestinations("ORD"));
+  REQUIRE(compressed.Dijkstras("CMI", "SYD") == plain.Dijkstras("CMI", "SYD"));
+  // Neighbors are visited in id order, so only the set of airports reached is the same
+  std::vector<std::string> plain_bfs = plain.BFS("CMI");
+  std::vector<std::string> compressed_bfs = compressed.BFS("CMI");
+  std::sort(plain_bfs.begin(), plain_bfs.end());
+  std::sort(compressed_bfs.begin(), compressed_bfs.end());
+  REQUIRE(compressed_bfs == plain_bfs);
+
+  REQUIRE(compressed.AddEdge("CMI", "SYD"));
+  REQUIRE(compressed.GetOrigins("SYD").size() == plain.GetOrigins("SYD").size() + 1);
+  REQUIRE(compressed.BFS("CMI").size() == plain.BFS("CMI").size());
+  compressed.SaveSnapshot("tests/compressed.snap");
+  Graph loaded = Graph::LoadSnapshot("tests/compressed.snap", options);
+  std::remove("tests/compressed.snap");
+  REQUIRE(loaded.BFS("CMI") == compressed.BFS("CMI"));
+}
+
+TEST_CASE("Vertex reordering", "[graph]") {
+  Graph file_order("tests/sample_airports.dat", "tests/sample_routes.dat");
+  for (VertexOrder order : {VertexOrder::kRCM, VertexOrder::kDegree, VertexOrder::kHilbert}) {
+    GraphOptions options;
+    options.order = order;
+    options.adjacency_matrix = true;
+    Graph g("tests/sample_airports.dat", "tests/sample_routes.dat", options);
+    REQUIRE(g.GetNumVertices() == file_order.GetNumVertices());
+    REQUIRE(g.GetNumEdges() == file_order.GetNumEdges());
+    for (uint32_t id = 0; id < g.GetNumVertices(); id++) {
+      REQUIRE(g.GetId(g.GetCode(id)) == id);
+      REQUIRE(g.FindVertex(g.GetCode(id)).GetName() == file_order.FindVertex(g.GetCode(id)).GetName());
+    }
+    // Adjacency lists keep their order, so traversals and paths are unchanged
+    REQUIRE(g.BFS("SEA") == file_order.BFS("SEA"));
+    REQUIRE(g.GetDestinations("ORD") == file_order.GetDestinations("ORD"));
+    REQUIRE(g.EdgeExists("ORD", "LAX"));
+    REQUIRE(!g.EdgeExists("ORD", "CLT"));
+    REQUIRE(g.Dijkstras("ORD", "JFK") == file_order.Dijkstras("ORD", "JFK"));
+  }
+  // Orders only depend on the graph, so a reordered graph keeps its ids through a snapshot
+  GraphOptions options;
+  options.order = VertexOrder::kHilbert;
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat", options);
+  g.SaveSnapshot("tests/reordered.snap");
+  Graph loaded = Graph::LoadSnapshot("tests/reordered.snap");
+  std::remove("tests/reordered.snap");
+  REQUIRE(loaded.GetId("ORD") == g.GetId("ORD"));
+  LocalityStats stats = g.GetLocalityStats();
+  REQUIRE(stats.same_line_fraction >= 0);
+  REQUIRE(stats.same_line_fraction <= 1);
+}
+
+TEST_CASE("Memory usage accounting", "[graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  MemoryBreakdown usage = g.MemoryUsage();
+  // At least one (target, weight) record and one target per edge
+  REQUIRE(usage.edge_records >= 20 * sizeof(Arc));
+  REQUIRE(usage.adjacency >= 20 * sizeof(uint32_t));
+  REQUIRE(usage.reverse_adjacency >= 20 * sizeof(uint32_t));
+  REQUIRE(usage.code_index >= PackedCode::kNumCodes * sizeof(uint32_t));
+  REQUIRE(usage.auxiliary_indexes == 0);
+  REQUIRE(usage.Total() == usage.vertex_metadata + usage.edge_records + usage.adjacency + usage.reverse_adjacency +
+                           usage.code_index + usage.auxiliary_indexes + usage.arena_slack);
+  GraphOptions options;
+  options.adjacency_matrix = true;
+  Graph matrix("tests/sample_airports.dat", "tests/sample_routes.dat", options);
+  // 10 rows of one 64 bit word
+  REQUIRE(matrix.MemoryUsage().auxiliary_indexes >= 10 * sizeof(uint64_t));
+}
+
+TEST_CASE("Arena allocation", "[arena][graph]") {
+  Arena arena(1024);
+  void* first = arena.Allocate(3, 1);
+  void* second = arena.Allocate(16, 8);
+  REQUIRE(reinterpret_cast<uintptr_t>(second) % 8 == 0);
+  REQUIRE(static_cast<char*>(second) >= static_cast<char*>(first) + 3);
+  REQUIRE(arena.NumBlocks() == 1);
+  // Large allocations get a block of their own
+  arena.Allocate(4096, 8);
+  REQUIRE(arena.NumBlocks() == 2);
+  REQUIRE(arena.BytesAllocated() == 3 + 16 + 4096);
+  REQUIRE(arena.BytesReserved() == 1024 + 4096);
+
+  Graph heap("tests/sample_airports.dat", "tests/sample_routes.dat", [] {
+    GraphOptions options;
+    options.arena_block_size = 0;
+    return options;
+  }());
+  Graph arena_graph("tests/sample_airports.dat", "tests/sample_routes.dat");
+  REQUIRE(heap.MemoryUsage().arena_slack == 0);
+  REQUIRE(arena_graph.BFS("SEA") == heap.BFS("SEA"));
+  REQUIRE(arena_graph.Dijkstras("SEA", "ORD") == heap.Dijkstras("SEA", "ORD"));
+  // Copies allocate from the heap and stay valid after the original and its arena are gone
+  Graph* original = new Graph("tests/sample_airports.dat", "tests/sample_routes.dat");
+  Graph copy(*original);
+  delete original;
+  REQUIRE(copy.MemoryUsage().arena_slack == 0);
+  REQUIRE(copy.BFS("SEA") == heap.BFS("SEA"));
+  REQUIRE(copy.FindVertex("SEA").GetName() == heap.FindVertex("SEA").GetName());
+
+  // The vertex arrays are allocated at their final size, so the arena holds no more than the heap graph
+  MemoryBreakdown full_heap = Graph("data/airports.dat", "data/routes.dat", [] {
+    GraphOptions options;
+    options.arena_block_size = 0;
+    return options;
+  }()).MemoryUsage();
+  MemoryBreakdown full_arena = Graph("data/airports.dat", "data/routes.dat").MemoryUsage();
+  REQUIRE(full_arena.vertex_metadata == full_heap.vertex_metadata);
+  REQUIRE(full_arena.arena_slack < 1024);
+}
+
+TEST_CASE("Parallel route parsing matches serial parsing", "[graph]") {
+  Graph serial("tests/sample_airports.dat", "tests/sample_routes.dat");
+  for (unsigned threads : {2u, 3u, 8u, 64u}) {
+    GraphOptions options;
+    options.threads = threads;
+    Graph parallel("tests/sample_airports.dat", "tests/sample_routes.dat", options);
+    REQUIRE(parallel.GetNumVertices() == serial.GetNumVertices());
+    REQUIRE(parallel.GetNumEdges() == serial.GetNumEdges());
+    // Adjacency order decides the traversal order, so it must match the serial parse exactly
+    REQUIRE(parallel.BFS("SEA") == serial.BFS("SEA"));
+    REQUIRE(parallel.GetDestinations("ORD") == serial.GetDestinations("ORD"));
+  }
+}
+
+TEST_CASE("Snapshot round trip", "[snapshot][graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  g.SetEdgeWeight("ORD", "LAX", 10);
+  g.SaveSnapshot("tests/sample.snap");
+  Graph loaded = Graph::LoadSnapshot("tests/sample.snap");
+  REQUIRE(loaded.GetNumVertices() == g.GetNumVertices());
+  REQUIRE(loaded.GetNumEdges() == g.GetNumEdges());
+  REQUIRE(loaded.GetVertex("ORD").GetName() == g.GetVertex("ORD").GetName());
+  REQUIRE(loaded.GetVertex("ORD").GetCity() == g.GetVertex("ORD").GetCity());
+  REQUIRE(loaded.GetVertex("ORD").GetCoords() == g.GetVertex("ORD").GetCoords());
+  // Adjacency order and modified weights are preserved
+  REQUIRE(loaded.BFS("SEA") == g.BFS("SEA"));
+  REQUIRE(loaded.Dijkstras("ORD", "LAX") == g.Dijkstras("ORD", "LAX"));
+
+  // Flipping a byte of the payload must be detected
+  std::fstream file("tests/sample.snap", std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(100);
+  file.put('\xff');
+  file.close();
+  REQUIRE_THROWS_AS(Graph::LoadSnapshot("tests/sample.snap"), std::runtime_error);
+  std::remove("tests/sample.snap");
+  REQUIRE_THROWS_AS(Graph::LoadSnapshot("tests/sample.snap"), std::runtime_error);
+}
+
 TEST_CASE("Testing BFS traversal", "[bfs][graph]") {
   Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
   std::vector<std::string> c = g.BFS("SEA");
@@ -81,6 +404,285 @@ TEST_CASE("BFS on small, unconnected graph", "[bfs][graph]") {
   REQUIRE(ord_bfs == ord_inorder);
 }
 
+TEST_CASE("Lazy BFS traversal", "[bfs][graph]") {
+  Graph g("data/airports.dat", "data/routes.dat");
+  for (const char* start : {"CMI", "ORD", "JFK"}) {
+    std::vector<std::string> lazy;
+    for (VertexView vertex : g.Traverse(start)) {
+      lazy.emplace_back(vertex.GetKey());
+    }
+    REQUIRE(lazy == g.BFS(start));
+  }
+  // Reading a prefix only expands the vertices before it
+  BFSTraversal traversal = g.Traverse("ORD");
+  std::vector<std::string> preview;
+  for (auto it = traversal.begin(); it != traversal.end() && preview.size() < 3; ++it) {
+    preview.emplace_back((*it).GetKey());
+  }
+  std::vector<std::string> full = g.BFS("ORD");
+  REQUIRE(preview == std::vector<std::string>(full.begin(), full.begin() + 3));
+  REQUIRE(g.Traverse("XXX").Done());
+  BFSTraversal empty = g.Traverse("XXX");
+  REQUIRE(empty.begin() == empty.end());
+}
+
+TEST_CASE("Direction-optimizing BFS", "[bfs][graph]") {
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat");
+  BFSTree tree = small.BFSLevels(small.GetId("ORD"));
+  REQUIRE(tree.levels[small.GetId("ORD")] == 0);
+  REQUIRE(tree.levels[small.GetId("JFK")] == BFSTree::kUnreached);
+  REQUIRE(tree.parents[small.GetId("ORD")] == Graph::kInvalidId);
+  REQUIRE(tree.parents[small.GetId("JFK")] == Graph::kInvalidId);
+
+  GraphOptions options;
+  options.compressed_adjacency = true;
+  Graph g("data/airports.dat", "data/routes.dat");
+  Graph compressed("data/airports.dat", "data/routes.dat", options);
+  for (const char* start : {"ORD", "CMI", "SYD"}) {
+    BFSTree top_down = g.BFSLevels(g.GetId(start), BFSStrategy::kTopDown);
+    BFSTree optimized = g.BFSLevels(g.GetId(start));
+    REQUIRE(optimized.levels == top_down.levels);
+    REQUIRE(compressed.BFSLevels(g.GetId(start)).levels == top_down.levels);
+    // Every parent is an in-neighbor one level closer to the start
+    bool parents_valid = true;
+    for (uint32_t v = 0; v < g.GetNumVertices(); v++) {
+      if (optimized.levels[v] == BFSTree::kUnreached || optimized.levels[v] == 0) continue;
+      uint32_t parent = optimized.parents[v];
+      parents_valid &= g.EdgeExists(parent, v) && optimized.levels[parent] + 1 == optimized.levels[v];
+    }
+    REQUIRE(parents_valid);
+    // Starting from a hub, the large middle levels are expanded bottom-up
+    if (std::string(start) == "ORD") REQUIRE(optimized.edges_examined < top_down.edges_examined);
+  }
+  // Every vertex reached by the traversal has a level
+  std::vector<std::string> reached = g.BFS("CMI");
+  BFSTree from_cmi = g.BFSLevels(g.GetId("CMI"));
+  REQUIRE(size_t(std::count_if(from_cmi.levels.begin(), from_cmi.levels.end(), [](uint32_t level) {
+            return level != BFSTree::kUnreached;
+          })) == reached.size());
+}
+
+TEST_CASE("Parallel BFS", "[bfs][graph]") {
+  Graph g("data/airports.dat", "data/routes.dat");
+  for (const char* start : {"ORD", "CMI"}) {
+    BFSTree serial = g.BFSLevels(g.GetId(start), BFSStrategy::kTopDown);
+    for (unsigned threads : {1u, 2u, 4u, 7u}) {
+      BFSTree parallel = g.ParallelBFSLevels(g.GetId(start), threads);
+      REQUIRE(parallel.levels == serial.levels);
+      REQUIRE(parallel.edges_examined == serial.edges_examined);
+      bool parents_valid = true;
+      for (uint32_t v = 0; v < g.GetNumVertices(); v++) {
+        if (parallel.levels[v] == BFSTree::kUnreached || parallel.levels[v] == 0) continue;
+        parents_valid &= g.EdgeExists(parallel.parents[v], v) && parallel.levels[parallel.parents[v]] + 1 == parallel.levels[v];
+      }
+      REQUIRE(parents_valid);
+    }
+  }
+  // Same airports as the serial traversal, level by level
+  std::vector<std::string> serial = g.BFS("CMI");
+  std::vector<std::string> parallel = g.BFS("CMI", 4);
+  BFSTree tree = g.BFSLevels(g.GetId("CMI"));
+  REQUIRE(parallel.front() == "CMI");
+  REQUIRE(std::is_sorted(parallel.begin(), parallel.end(), [&](const std::string& a, const std::string& b) {
+    return tree.levels[g.GetId(a)] < tree.levels[g.GetId(b)];
+  }));
+  std::sort(serial.begin(), serial.end());
+  std::sort(parallel.begin(), parallel.end());
+  REQUIRE(parallel == serial);
+  REQUIRE(g.BFS("XXX", 4).empty());
+}
+
+TEST_CASE("Hop-limited reachability", "[bfs][graph]") {
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat");
+  std::vector<ReachedVertex> none = small.ReachableWithin("ORD", 0);
+  REQUIRE(none.size() == 1);
+  REQUIRE(none[0].id == small.GetId("ORD"));
+  REQUIRE(none[0].hops == 0);
+  REQUIRE(none[0].parent == Graph::kInvalidId);
+  REQUIRE(small.ReachableWithin("JFK", 5).size() == 1);
+  REQUIRE(small.ReachableWithin("XXX", 5).empty());
+
+  Graph g("data/airports.dat", "data/routes.dat");
+  BFSTree tree = g.BFSLevels(g.GetId("CMI"));
+  for (unsigned max_legs : {1u, 2u, 3u, 20u}) {
+    std::vector<ReachedVertex> reached = g.ReachableWithin("CMI", max_legs);
+    size_t expected = std::count_if(tree.levels.begin(), tree.levels.end(), [&](uint32_t level) {
+      return level <= max_legs;
+    });
+    REQUIRE(reached.size() == expected);
+    bool valid = true;
+    for (const ReachedVertex& vertex : reached) {
+      valid &= vertex.hops == tree.levels[vertex.id];
+      if (vertex.hops > 0) valid &= g.EdgeExists(vertex.parent, vertex.id) && tree.levels[vertex.parent] + 1 == vertex.hops;
+    }
+    REQUIRE(valid);
+  }
+}
+
+TEST_CASE("All pairs hop counts", "[bfs][graph]") {
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat");
+  HopMatrix hops = small.AllPairsHops();
+  REQUIRE(hops.GetNumVertices() == 5);
+  REQUIRE(hops.Get(small.GetId("ORD"), small.GetId("ORD")) == 0);
+  REQUIRE(hops.Get(small.GetId("ORD"), small.GetId("JFK")) == HopMatrix::kUnreachable);
+  REQUIRE(hops.Get(small.GetId("JFK"), small.GetId("ORD")) == HopMatrix::kUnreachable);
+
+  // More than 64 vertices, so several batches including a partial one
+  Graph g("data/airports.dat", "data/routes.dat");
+  HopMatrix all = g.AllPairsHops();
+  HopMatrix parallel = g.AllPairsHops(3);
+  bool matches_bfs = true;
+  for (uint32_t source = 0; source < g.GetNumVertices(); source += 61) {
+    BFSTree tree = g.BFSLevels(source);
+    for (uint32_t v = 0; v < g.GetNumVertices(); v++) {
+      uint8_t expected = tree.levels[v] == BFSTree::kUnreached ? HopMatrix::kUnreachable : tree.levels[v];
+      matches_bfs &= all.Get(source, v) == expected && parallel.Get(source, v) == expected;
+    }
+  }
+  REQUIRE(matches_bfs);
+  std::vector<uint64_t> counts = all.CountPairsByHops();
+  REQUIRE(counts[0] == 0);
+  // Pairs one leg apart are the routes, less any route from an airport to itself
+  REQUIRE(counts[1] <= g.GetNumEdges());
+  REQUIRE(counts[1] + 1 >= g.GetNumEdges());
+}
+
+TEST_CASE("Connected components", "[components][graph]") {
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat");
+  Components weak = small.WeaklyConnectedComponents();
+  REQUIRE(weak.sizes.size() == 2);
+  REQUIRE(weak.component[small.GetId("JFK")] != weak.component[small.GetId("ORD")]);
+  REQUIRE(weak.sizes[weak.component[small.GetId("ORD")]] == 4);
+  Components strong = small.StronglyConnectedComponents();
+  // ORD only has outgoing routes, so it is a component on its own
+  REQUIRE(strong.sizes[strong.component[small.GetId("ORD")]] == 1);
+  Graph cycle("tests/sample_airports.dat", "tests/sample_routes.dat");
+  REQUIRE(cycle.StronglyConnectedComponents().sizes == std::vector<uint32_t>{10});
+
+  Graph g("data/airports.dat", "data/routes.dat");
+  strong = g.StronglyConnectedComponents();
+  weak = g.WeaklyConnectedComponents();
+  REQUIRE(strong.component.size() == g.GetNumVertices());
+  HopMatrix hops = g.AllPairsHops();
+  bool consistent = true;
+  for (uint32_t source = 0; source < g.GetNumVertices(); source += 37) {
+    for (uint32_t v = 0; v < g.GetNumVertices(); v++) {
+      bool reachable = hops.Get(source, v) != HopMatrix::kUnreachable;
+      bool mutual = reachable && hops.Get(v, source) != HopMatrix::kUnreachable;
+      consistent &= (strong.component[source] == strong.component[v]) == mutual;
+      // Reachable vertices share a weak component, and routes never lead to a higher numbered strong component
+      if (reachable) {
+        consistent &= weak.component[source] == weak.component[v];
+        consistent &= strong.component[v] <= strong.component[source];
+      }
+    }
+  }
+  REQUIRE(consistent);
+}
+
+TEST_CASE("Diameter and eccentricity bounds", "[components][graph]") {
+  // Every airport of the 10-cycle with routes both ways is 5 legs from the opposite one
+  Graph cycle("tests/sample_airports.dat", "tests/sample_routes.dat");
+  EccentricityStats stats = cycle.Eccentricities(4);
+  REQUIRE(stats.diameter == 5);
+  REQUIRE(stats.radius_upper == 5);
+  for (uint32_t v = 0; v < cycle.GetNumVertices(); v++) {
+    REQUIRE(stats.eccentricity_lower[v] <= 5);
+    REQUIRE(stats.eccentricity_upper[v] == 5);
+  }
+
+  Graph g("data/airports.dat", "data/routes.dat");
+  stats = g.Eccentricities(8, 3);
+  Components strong = g.StronglyConnectedComponents();
+  HopMatrix hops = g.AllPairsHops();
+  uint32_t diameter = 0;
+  uint32_t radius = UINT32_MAX;
+  size_t members = 0;
+  bool bounded = true;
+  for (uint32_t v = 0; v < g.GetNumVertices(); v++) {
+    if (strong.component[v] != stats.component) {
+      bounded &= stats.eccentricity_lower[v] == BFSTree::kUnreached;
+      continue;
+    }
+    members++;
+    uint32_t eccentricity = 0;
+    for (uint32_t w = 0; w < g.GetNumVertices(); w++) {
+      if (strong.component[w] == stats.component) eccentricity = std::max<uint32_t>(eccentricity, hops.Get(v, w));
+    }
+    diameter = std::max(diameter, eccentricity);
+    radius = std::min(radius, eccentricity);
+    bounded &= stats.eccentricity_lower[v] <= eccentricity && eccentricity <= stats.eccentricity_upper[v];
+  }
+  REQUIRE(bounded);
+  REQUIRE(members == *std::max_element(strong.sizes.begin(), strong.sizes.end()));
+  REQUIRE(stats.diameter == diameter);
+  REQUIRE(stats.radius_lower <= radius);
+  REQUIRE(radius <= stats.radius_upper);
+  REQUIRE(stats.sample_bfs_runs == 16);
+  REQUIRE(stats.diameter_bfs_runs < members / 10);
+
+  // An empty graph has nothing to measure
+  Graph empty("tests/invalid-airports.dat", "tests/sample_routes.dat");
+  stats = empty.Eccentricities();
+  REQUIRE(stats.diameter == 0);
+  REQUIRE(stats.eccentricity_lower.empty());
+}
+
+TEST_CASE("Diameter of random strongly connected graphs", "[components][graph]") {
+  // Small graphs give diFUB odd lower bounds and short fringes, where stopping a level early misses the diameter
+  std::mt19937 rng(22);
+  // The graphs are written to a private temporary directory, never into the source tree
+  char dir[] = "/tmp/graph_test_XXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  std::string airports_path = std::string(dir) + "/airports.dat";
+  std::string routes_path = std::string(dir) + "/routes.dat";
+  bool exact = true;
+  bool bounded = true;
+  for (int trial = 0; trial < 1000; trial++) {
+    uint32_t n = 4 + rng() % 12;
+    std::vector<uint32_t> order(n);
+    for (uint32_t v = 0; v < n; v++) {
+      order[v] = v;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    {
+      std::ofstream airports(airports_path);
+      for (uint32_t v = 0; v < n; v++) {
+        airports << v << ",\"Airport " << v << "\",\"City\",\"Country\",\"A" << v / 10 << v % 10 << "\",\"XXXX\","
+                 << v << "," << v << ",0,0,\"A\",\"UTC\",\"airport\",\"OurAirports\"\n";
+      }
+      // A cycle through every airport in random order makes the graph strongly connected, plus a few extra routes
+      std::ofstream routes(routes_path);
+      for (uint32_t i = 0; i < n; i++) {
+        uint32_t from = order[i], to = order[(i + 1) % n];
+        routes << "AA,1,A" << from / 10 << from % 10 << ",1,A" << to / 10 << to % 10 << ",1,,0,738\n";
+      }
+      for (uint32_t i = rng() % (2 * n); i > 0; i--) {
+        uint32_t from = rng() % n, to = rng() % n;
+        if (from == to) continue;
+        routes << "AA,1,A" << from / 10 << from % 10 << ",1,A" << to / 10 << to % 10 << ",1,,0,738\n";
+      }
+    }
+    Graph g(airports_path, routes_path);
+    EccentricityStats stats = g.Eccentricities(2);
+    HopMatrix hops = g.AllPairsHops();
+    uint32_t diameter = 0;
+    for (uint32_t v = 0; v < n; v++) {
+      uint32_t eccentricity = 0;
+      for (uint32_t w = 0; w < n; w++) {
+        eccentricity = std::max<uint32_t>(eccentricity, hops.Get(v, w));
+      }
+      diameter = std::max(diameter, eccentricity);
+      bounded = bounded && stats.eccentricity_lower[v] <= eccentricity && eccentricity <= stats.eccentricity_upper[v];
+    }
+    exact = exact && g.GetNumVertices() == n && stats.diameter == diameter;
+  }
+  std::remove(airports_path.c_str());
+  std::remove(routes_path.c_str());
+  rmdir(dir);
+  REQUIRE(exact);
+  REQUIRE(bounded);
+}
 
 TEST_CASE("Test distance function", "[dist][utils]") {
   Coord first(37.773972, -122.431297);
@@ -123,6 +725,163 @@ TEST_CASE("Dijkstras chooses multiple node path over direct path", "[dijkstras][
   REQUIRE(path == "ORD -> DFW -> DEN -> JFK -> SFO -> LAS -> SEA -> CLT -> ATL -> LAX");
 }
 
+TEST_CASE("Setting edge weights in place", "[dijkstras][graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  // Setting the weight of a route that doesn't exist is ignored
+  g.SetEdgeWeight("ORD", "CLT", 1);
+  REQUIRE(!g.EdgeExists("ORD", "CLT"));
+  REQUIRE(g.GetNumEdges() == 20);
+  g.SetEdgeWeight("ORD", "LAX", 0.5);
+  g.SetEdgeWeight("LAX", "ATL", 0.5);
+  g.SetEdgeWeight("ATL", "CLT", 0.5);
+  auto path = g.Dijkstras("ORD", "CLT");
+  REQUIRE(path.first == "ORD -> LAX -> ATL -> CLT");
+  REQUIRE(path.second == 1.5);
+}
+
+TEST_CASE("Priority queue policies pop in key order", "[dijkstras][queues]") {
+  BinaryHeapQueue binary;
+  QuaternaryHeapQueue quaternary;
+  PairingHeapQueue pairing;
+  RadixHeapQueue radix;
+  auto drain = [](auto& queue) {
+    // Lowering keys mixed with pops that never go below the last key popped, as in Dijkstra's algorithm
+    queue.Reset(8);
+    queue.Push(5, 0);
+    queue.Push(3, 1);
+    queue.Push(9, 2);
+    queue.Push(4, 3);
+    std::vector<uint32_t> order = {queue.Pop().id};
+    queue.Push(3.5, 2);
+    queue.Push(7, 4);
+    queue.Push(3.25, 0);
+    std::vector<bool> seen(8);
+    while (!queue.Empty()) {
+      QueueEntry entry = queue.Pop();
+      if (seen[entry.id]) continue;
+      seen[entry.id] = true;
+      order.push_back(entry.id);
+    }
+    return order;
+  };
+  std::vector<uint32_t> expected = {1, 0, 2, 3, 4};
+  REQUIRE(drain(binary) == expected);
+  REQUIRE(drain(quaternary) == expected);
+  REQUIRE(drain(pairing) == expected);
+  REQUIRE(drain(radix) == expected);
+  // Queues are reusable after Reset
+  REQUIRE(drain(pairing) == expected);
+  REQUIRE(drain(radix) == expected);
+}
+
+TEST_CASE("Every priority queue policy finds the same shortest distances", "[dijkstras][graph]") {
+  Graph g("data/airports.dat", "data/routes.dat");
+  const QueuePolicy policies[] = {QueuePolicy::kQuaternaryHeap, QueuePolicy::kPairingHeap, QueuePolicy::kRadixHeap};
+  bool same = true;
+  for (uint32_t i = 0; i < 200; i++) {
+    uint32_t source = i * 37 % g.GetNumVertices();
+    uint32_t target = i * 101 % g.GetNumVertices();
+    ShortestPath expected = g.ShortestRoute(source, target);
+    for (QueuePolicy policy : policies) {
+      ShortestPath route = g.ShortestRoute(source, target, policy);
+      same = same && route.distance == expected.distance && route.vertices.empty() == expected.vertices.empty();
+    }
+  }
+  REQUIRE(same);
+  // Selected at compile time
+  ShortestPath route = g.ShortestRoute<PairingHeapQueue>(g.GetId("CMI"), g.GetId("SYD"));
+  REQUIRE(route.vertices.front() == g.GetId("CMI"));
+  REQUIRE(route.vertices.back() == g.GetId("SYD"));
+  REQUIRE(route.distance == g.Dijkstras("CMI", "SYD").second);
+  REQUIRE(route.settled > 0);
+  REQUIRE(route.settled <= g.GetNumVertices());
+}
+
+TEST_CASE("Shortest path searches reuse a workspace", "[dijkstras][graph]") {
+  Graph g("data/airports.dat", "data/routes.dat");
+  Graph small("tests/airports_small.dat", "tests/routes_small.dat");
+  SearchWorkspace workspace;
+  // A search that settles most of the graph, then searches that must not see its labels
+  ShortestPath longest = g.ShortestRoute<BinaryHeapQueue>(g.GetId("CMI"), g.GetId("SYD"), workspace);
+  REQUIRE(longest.distance == g.Dijkstras("CMI", "SYD").second);
+  ShortestPath nearby = g.ShortestRoute<BinaryHeapQueue>(g.GetId("ORD"), g.GetId("MDW"), workspace);
+  REQUIRE(nearby.distance == g.Dijkstras("ORD", "MDW").second);
+  REQUIRE(nearby.settled < longest.settled);
+  // The same workspace searches a smaller graph
+  ShortestPath route = small.ShortestRoute<RadixHeapQueue>(small.GetId("ORD"), small.GetId("ATL"), workspace);
+  REQUIRE(route.vertices.size() == 3);
+  REQUIRE(small.GetCode(route.vertices[1]) == "CLT");
+  ShortestPath none = small.ShortestRoute<PairingHeapQueue>(small.GetId("ORD"), small.GetId("JFK"), workspace);
+  REQUIRE(none.vertices.empty());
+  REQUIRE(none.distance == std::numeric_limits<double>::max());
+  // Repeating a search gives the same route
+  ShortestPath again = g.ShortestRoute<BinaryHeapQueue>(g.GetId("CMI"), g.GetId("SYD"), workspace);
+  REQUIRE(again.vertices == longest.vertices);
+  REQUIRE(again.settled == longest.settled);
+}
+
+TEST_CASE("A* search with the great-circle heuristic", "[astar][dijkstras][graph]") {
+  Graph g("data/airports.dat", "data/routes.dat");
+  REQUIRE(g.HasGeodesicWeights());
+  bool same = true;
+  bool bounded = true;
+  uint64_t dijkstra_settled = 0;
+  uint64_t astar_settled = 0;
+  for (uint32_t i = 0; i < 200; i++) {
+    uint32_t source = i * 37 % g.GetNumVertices();
+    uint32_t target = i * 101 % g.GetNumVertices();
+    ShortestPath dijkstra = g.ShortestRoute(source, target);
+    ShortestPath astar = g.AStarRoute(source, target);
+    ShortestPath radix = g.AStarRoute(source, target, 1, QueuePolicy::kRadixHeap);
+    ShortestPath weighted = g.AStarRoute(source, target, 1.5, QueuePolicy::kPairingHeap);
+    ShortestPath weighted_radix = g.AStarRoute(source, target, 1.5, QueuePolicy::kRadixHeap);
+    same = same && astar.distance == dijkstra.distance && radix.distance == dijkstra.distance;
+    bounded = bounded && weighted.vertices.empty() == dijkstra.vertices.empty() &&
+              (dijkstra.vertices.empty() || weighted.distance <= 1.5 * dijkstra.distance) &&
+              weighted_radix.vertices.empty() == dijkstra.vertices.empty() &&
+              (dijkstra.vertices.empty() || weighted_radix.distance <= 1.5 * dijkstra.distance);
+    if (!dijkstra.vertices.empty()) {
+      dijkstra_settled += dijkstra.settled;
+      astar_settled += astar.settled;
+    }
+  }
+  REQUIRE(same);
+  REQUIRE(bounded);
+  REQUIRE(astar_settled * 2 < dijkstra_settled);
+  ShortestPath route = g.AStarRoute(g.GetId("CMI"), g.GetId("SYD"));
+  REQUIRE(route.distance == g.Dijkstras("CMI", "SYD").second);
+  REQUIRE(route.settled < g.ShortestRoute(g.GetId("CMI"), g.GetId("SYD")).settled);
+  REQUIRE_THROWS_AS(g.AStarRoute(0, 1, 0.5), std::invalid_argument);
+}
+
+TEST_CASE("A* falls back to Dijkstra when a weight is below the great circle", "[astar][dijkstras][graph]") {
+  Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
+  // Making a route longer keeps the heuristic valid
+  g.SetEdgeWeight("ORD", "LAX", 100000);
+  REQUIRE(g.HasGeodesicWeights());
+  // Same weights as "Dijkstras chooses multiple node path over direct path", far below the real distances
+  g.SetEdgeWeight("ORD", "LAX", 10);
+  g.SetEdgeWeight("ORD", "DFW", 1);
+  g.SetEdgeWeight("DFW", "DEN", 1);
+  g.SetEdgeWeight("DEN", "JFK", 1);
+  g.SetEdgeWeight("JFK", "SFO", 1);
+  g.SetEdgeWeight("SFO", "LAS", 1);
+  g.SetEdgeWeight("LAS", "SEA", 1);
+  g.SetEdgeWeight("SEA", "CLT", 1);
+  g.SetEdgeWeight("CLT", "ATL", 1);
+  g.SetEdgeWeight("ATL", "LAX", 1);
+  REQUIRE(!g.HasGeodesicWeights());
+  ShortestPath route = g.AStarRoute(g.GetId("ORD"), g.GetId("LAX"));
+  REQUIRE(route.distance == 9);
+  REQUIRE(route.vertices.size() == 10);
+  // Snapshots keep the changed weights, so the loaded graph falls back too
+  g.SaveSnapshot("tests/astar_test.snap");
+  Graph loaded = Graph::LoadSnapshot("tests/astar_test.snap");
+  std::remove("tests/astar_test.snap");
+  REQUIRE(!loaded.HasGeodesicWeights());
+  REQUIRE(loaded.AStarRoute(loaded.GetId("ORD"), loaded.GetId("LAX")).distance == 9);
+}
+
 TEST_CASE("Page rank on sample data", "[pagerank][graph]") {
   Graph g("tests/sample_airports.dat", "tests/sample_routes.dat");
   const auto & rank = g.PageRank();
@@ -148,3 +907,70 @@ TEST_CASE("Page rank on small unconnected graph", "[pagerank][graph]") {
    REQUIRE(Approx(rank.second[i].first) == test[i]);
   }
 }
+
+TEST_CASE("Adding and removing edges", "[graph]") {
+  Graph g("tests/airports_small.dat", "tests/routes_small.dat");
+  REQUIRE(g.AddEdge("ORD", "JFK"));
+  REQUIRE(!g.AddEdge("ORD", "JFK"));
+  REQUIRE(!g.AddEdge("ORD", "LGA"));
+  REQUIRE(g.EdgeExists("ORD", "JFK"));
+  REQUIRE(g.GetNumEdges() == 5);
+  REQUIRE(g.GetOrigins("JFK") == std::vector<std::string>{"ORD"});
+  REQUIRE(g.BFS("ORD") == std::vector<std::string>{"ORD", "LAX", "CLT", "JFK", "ATL"});
+  REQUIRE(g.RemoveEdge("ORD", "CLT"));
+  REQUIRE(!g.RemoveEdge("ORD", "CLT"));
+  REQUIRE(g.GetNumEdges() == 4);
+  REQUIRE(g.Dijkstras("ORD", "ATL").first == "ORD -> LAX -> ATL");
+  REQUIRE(g.GetOrigins("CLT").empty());
+}
+
+TEST_CASE("Graph store publishes versions to concurrent readers", "[store][graph]") {
+  GraphStore store(Graph("tests/sample_airports.dat", "tests/sample_routes.dat"));
+  FrozenGraph original = store.Current();
+  REQUIRE(store.GetVersion() == 0);
+  std::atomic<bool> done(false);
+  std::atomic<bool> consistent(true);
+  // Each version sets both directions of ORD <-> LAX to the same weight; a reader must never see them differ
+  auto read = [&]() {
+    GraphStore::Reader reader(store);
+    uint64_t last = 0;
+    while (!done) {
+      const Graph& g = reader.Get();
+      if (reader.GetVersion() < last) consistent = false;
+      last = reader.GetVersion();
+      if (g.Dijkstras("ORD", "LAX").second != g.Dijkstras("LAX", "ORD").second) consistent = false;
+    }
+  };
+  // Takes a handle to the latest version on every query instead of caching one
+  auto read_current = [&]() {
+    while (!done) {
+      FrozenGraph g = store.Current();
+      if (g->Dijkstras("ORD", "LAX").second != g->Dijkstras("LAX", "ORD").second) consistent = false;
+    }
+  };
+  std::thread first(read);
+  std::thread second(read);
+  std::thread third(read_current);
+  for (int i = 1; i <= 50; i++) {
+    uint64_t version = store.Update([i](Graph& g) {
+      g.SetEdgeWeight("ORD", "LAX", i);
+      g.SetEdgeWeight("LAX", "ORD", i);
+    });
+    REQUIRE(version == uint64_t(i));
+  }
+  done = true;
+  first.join();
+  second.join();
+  third.join();
+  REQUIRE(consistent);
+  REQUIRE(store.Current()->Dijkstras("ORD", "LAX").second == 50);
+  // Versions held by readers are never modified
+  REQUIRE(original->Dijkstras("ORD", "LAX") == Graph("tests/sample_airports.dat", "tests/sample_routes.dat").Dijkstras("ORD", "LAX"));
+  store.Update([](Graph& g) { g.RemoveEdge("ORD", "LAX"); });
+  REQUIRE(!store.Current()->EdgeExists("ORD", "LAX"));
+  REQUIRE(original->EdgeExists("ORD", "LAX"));
+  // Once no reader holds a replaced version, the store releases it too
+  std::weak_ptr<const Graph> replaced = store.Current();
+  store.Update([](Graph& g) { g.SetEdgeWeight("ORD", "DFW", 1); });
+  REQUIRE(replaced.expired());
+}
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "graph.h"
+
+namespace {
+
+// Switching thresholds from Beamer, Asanovic and Patterson, "Direction-Optimizing Breadth-First Search" (2012)
+// Go bottom-up once the frontier's outgoing edges exceed 1/kAlpha of the edges still unexplored
+const uint64_t kAlpha = 14;
+// Go back to top-down once the frontier holds fewer than 1/kBeta of the vertices
+const uint64_t kBeta = 24;
+// Frontier vertices a thread claims at a time in a parallel search, small enough to balance hubs between threads
+const size_t kFrontierGrain = 32;
+
+// Blocks each of a fixed number of threads until all of them have arrived, reusable (std::barrier needs C++20)
+class Barrier {
+  public:
+    explicit Barrier(unsigned count) : count(count), waiting(0), generation(0) {}
+    void Wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      uint64_t arrived = generation;
+      if (++waiting == count) {
+        waiting = 0;
+        generation++;
+        condition.notify_all();
+        return;
+      }
+      condition.wait(lock, [&] {
+        return generation != arrived;
+      });
+    }
+  private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    unsigned count;
+    unsigned waiting;
+    uint64_t generation;
+};
+
+}  // namespace
+
+/**
+* Breadth-first search from one vertex over integer ids, with optional bottom-up levels
+* @param start id of the start vertex
+* @param strategy how each level is expanded
+* @return the level and parent of every vertex
+*/
+BFSTree Graph::BFSLevels(uint32_t start, BFSStrategy strategy) const {
+  uint32_t n = vertices.size();
+  BFSTree tree;
+  tree.levels.assign(n, BFSTree::kUnreached);
+  tree.parents.assign(n, kInvalidId);
+  tree.edges_examined = 0;
+  if (start >= n) return tree;
+
+  size_t words = (n + 63) / 64;
+  std::vector<uint64_t> visited(words, 0);
+  // Bitmap of the current frontier, only filled for bottom-up levels
+  std::vector<uint64_t> frontier_bits(words, 0);
+  std::vector<uint32_t> frontier = {start};
+  std::vector<uint32_t> next;
+  tree.levels[start] = 0;
+  visited[start / 64] |= uint64_t(1) << (start % 64);
+  // Incoming edges of the unvisited vertices, which is the most a bottom-up level can look at
+  uint64_t unexplored_edges = arcs.size() - (in_offsets[start + 1] - in_offsets[start]);
+  bool bottom_up = false;
+
+  for (uint32_t level = 1; !frontier.empty(); level++) {
+    if (strategy == BFSStrategy::kDirectionOptimizing) {
+      uint64_t frontier_edges = 0;
+      for (uint32_t u : frontier) {
+        frontier_edges += offsets[u + 1] - offsets[u];
+      }
+      if (!bottom_up && frontier_edges > unexplored_edges / kAlpha) {
+        bottom_up = true;
+      } else if (bottom_up && frontier.size() < n / kBeta) {
+        bottom_up = false;
+      }
+    }
+    next.clear();
+    if (bottom_up) {
+      std::fill(frontier_bits.begin(), frontier_bits.end(), 0);
+      for (uint32_t u : frontier) {
+        frontier_bits[u / 64] |= uint64_t(1) << (u % 64);
+      }
+      // Vertices are scanned in id order, so the next frontier comes out sorted
+      for (size_t word = 0; word < words; word++) {
+        uint64_t unvisited = ~visited[word];
+        if (word == words - 1 && n % 64 != 0) unvisited &= (uint64_t(1) << (n % 64)) - 1;
+        while (unvisited) {
+          uint32_t v = word * 64 + __builtin_ctzll(unvisited);
+          unvisited &= unvisited - 1;
+          ForEachSource(v, [&](uint32_t u) {
+            tree.edges_examined++;
+            if (!(frontier_bits[u / 64] >> (u % 64) & 1)) return false;
+            tree.parents[v] = u;
+            return true;
+          });
+          if (tree.parents[v] == kInvalidId) continue;
+          tree.levels[v] = level;
+          visited[word] |= uint64_t(1) << (v % 64);
+          unexplored_edges -= in_offsets[v + 1] - in_offsets[v];
+          next.push_back(v);
+        }
+      }
+    } else {
+      for (uint32_t u : frontier) {
+        ForEachTarget(u, [&](uint32_t v) {
+          tree.edges_examined++;
+          if (visited[v / 64] >> (v % 64) & 1) return;
+          visited[v / 64] |= uint64_t(1) << (v % 64);
+          tree.levels[v] = level;
+          tree.parents[v] = u;
+          unexplored_edges -= in_offsets[v + 1] - in_offsets[v];
+          next.push_back(v);
+        });
+      }
+    }
+    frontier.swap(next);
+  }
+  return tree;
+}
+
+/**
+* Level-synchronous breadth-first search where threads expand parts of each frontier at the same time. A vertex is
+* claimed by the first thread to set its bit in an atomic visited bitmap, and each thread collects the vertices it
+* claims in its own buffer. The buffers form the next frontier once every thread has finished the level
+* @param start id of the start vertex
+* @param threads number of threads, including the calling thread
+* @return the level and parent of every vertex
+*/
+BFSTree Graph::ParallelBFSLevels(uint32_t start, unsigned threads) const {
+  uint32_t n = vertices.size();
+  BFSTree tree;
+  tree.levels.assign(n, BFSTree::kUnreached);
+  tree.parents.assign(n, kInvalidId);
+  tree.edges_examined = 0;
+  if (start >= n) return tree;
+  if (threads == 0) threads = 1;
+
+  std::vector<std::atomic<uint64_t>> visited((n + 63) / 64);
+  for (auto& word : visited) {
+    word.store(0, std::memory_order_relaxed);
+  }
+  visited[start / 64].store(uint64_t(1) << (start % 64), std::memory_order_relaxed);
+  tree.levels[start] = 0;
+  std::vector<uint32_t> frontier = {start};
+  std::vector<std::vector<uint32_t>> claimed(threads);
+  std::atomic<size_t> cursor(0);
+  std::atomic<uint64_t> edges_examined(0);
+  uint32_t level = 1;
+  Barrier barrier(threads);
+
+  auto expand = [&](unsigned worker) {
+    std::vector<uint32_t>& local = claimed[worker];
+    uint64_t examined = 0;
+    while (!frontier.empty()) {
+      for (size_t begin = cursor.fetch_add(kFrontierGrain); begin < frontier.size();
+           begin = cursor.fetch_add(kFrontierGrain)) {
+        size_t end = std::min(begin + kFrontierGrain, frontier.size());
+        for (size_t i = begin; i < end; i++) {
+          uint32_t u = frontier[i];
+          ForEachTarget(u, [&](uint32_t v) {
+            examined++;
+            uint64_t bit = uint64_t(1) << (v % 64);
+            // The plain load skips the atomic write for vertices that are already visited, the common case
+            if (visited[v / 64].load(std::memory_order_relaxed) & bit) return;
+            if (visited[v / 64].fetch_or(bit, std::memory_order_relaxed) & bit) return;
+            // Only the thread that claimed v writes its entries
+            tree.levels[v] = level;
+            tree.parents[v] = u;
+            local.push_back(v);
+          });
+        }
+      }
+      barrier.Wait();
+      if (worker == 0) {
+        frontier.clear();
+        for (auto& buffer : claimed) {
+          frontier.insert(frontier.end(), buffer.begin(), buffer.end());
+          buffer.clear();
+        }
+        cursor.store(0);
+        level++;
+      }
+      barrier.Wait();
+    }
+    edges_examined += examined;
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned worker = 1; worker < threads; worker++) {
+    workers.emplace_back(expand, worker);
+  }
+  expand(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  tree.edges_examined = edges_examined;
+  return tree;
+}
+
+/**
+* Starts a lazy traversal, queueing only the start vertex
+* @param graph the graph to traverse
+* @param start id of the start vertex, or Graph::kInvalidId for an empty traversal
+*/
+BFSTraversal::BFSTraversal(const Graph* graph, uint32_t start) : graph(graph), head(0) {
+  if (start == Graph::kInvalidId) return;
+  visited.assign((graph->GetNumVertices() + 63) / 64, 0);
+  visited[start / 64] |= uint64_t(1) << (start % 64);
+  queue.push_back(start);
+}
+
+bool BFSTraversal::Done() const {
+  return head == queue.size();
+}
+
+VertexView BFSTraversal::Current() const {
+  return VertexView(graph, queue[head]);
+}
+
+void BFSTraversal::Next() {
+  uint32_t u = queue[head++];
+  graph->ForEachTarget(u, [&](uint32_t v) {
+    if (visited[v / 64] >> (v % 64) & 1) return;
+    visited[v / 64] |= uint64_t(1) << (v % 64);
+    queue.push_back(v);
+  });
+}
+
+BFSTraversal Graph::Traverse(std::string_view start) const {
+  return BFSTraversal(this, GetId(start));
+}
+
+/**
+* Breadth-first search that stops after a number of levels
+* @param code airport code of the start
+* @param max_legs the most flights allowed
+* @return the reached vertices with their hop counts and parents, in breadth-first order
+*/
+std::vector<ReachedVertex> Graph::ReachableWithin(std::string_view code, unsigned max_legs) const {
+  uint32_t start = GetId(code);
+  if (start == kInvalidId) return {};
+  // Levels are contiguous in breadth-first order, so the result doubles as the queue
+  std::vector<ReachedVertex> reached = {{start, 0, kInvalidId}};
+  std::vector<uint64_t> visited((vertices.size() + 63) / 64, 0);
+  visited[start / 64] |= uint64_t(1) << (start % 64);
+  for (size_t i = 0; i < reached.size() && reached[i].hops < max_legs; i++) {
+    uint32_t u = reached[i].id;
+    uint32_t hops = reached[i].hops + 1;
+    ForEachTarget(u, [&](uint32_t v) {
+      if (visited[v / 64] >> (v % 64) & 1) return;
+      visited[v / 64] |= uint64_t(1) << (v % 64);
+      reached.push_back({v, hops, u});
+    });
+  }
+  return reached;
+}
+
+HopMatrix::HopMatrix() : size(0) {}
+
+uint32_t HopMatrix::GetNumVertices() const {
+  return size;
+}
+
+uint8_t HopMatrix::Get(uint32_t from, uint32_t to) const {
+  return hops[size_t(from) * size + to];
+}
+
+std::vector<uint64_t> HopMatrix::CountPairsByHops() const {
+  std::vector<uint64_t> counts(kUnreachable, 0);
+  for (uint8_t hop : hops) {
+    if (hop != kUnreachable) counts[hop]++;
+  }
+  // Drops the pairs of a vertex with itself, then the unused high counts
+  counts[0] -= size;
+  while (counts.size() > 1 && counts.back() == 0) {
+    counts.pop_back();
+  }
+  return counts;
+}
+
+/**
+* Multi-source breadth-first searches from every vertex, 64 sources per batch (Then et al., "The More the Merrier:
+* Efficient Multi-Source Graph Traversal", 2014). Bit i of a vertex's words belongs to the i-th source of the batch
+* @param threads number of threads, each running whole batches
+* @return hop counts between every pair of vertices
+*/
+HopMatrix Graph::AllPairsHops(unsigned threads) const {
+  uint32_t n = vertices.size();
+  HopMatrix matrix;
+  matrix.size = n;
+  matrix.hops.assign(size_t(n) * n, HopMatrix::kUnreachable);
+  uint32_t num_batches = (n + 63) / 64;
+  std::atomic<uint32_t> next_batch(0);
+
+  auto run_batches = [&]() {
+    // Sources of the batch that have reached, are on the frontier of, and will next reach each vertex
+    std::vector<uint64_t> seen(n), frontier(n), next(n);
+    for (uint32_t batch = next_batch++; batch < num_batches; batch = next_batch++) {
+      uint32_t first = batch * 64;
+      uint32_t count = std::min<uint32_t>(64, n - first);
+      std::fill(seen.begin(), seen.end(), 0);
+      std::fill(frontier.begin(), frontier.end(), 0);
+      for (uint32_t i = 0; i < count; i++) {
+        seen[first + i] = frontier[first + i] = uint64_t(1) << i;
+        matrix.hops[size_t(first + i) * n + first + i] = 0;
+      }
+      bool active = true;
+      for (uint32_t level = 1; active; level++) {
+        std::fill(next.begin(), next.end(), 0);
+        for (uint32_t u = 0; u < n; u++) {
+          uint64_t sources = frontier[u];
+          if (sources == 0) continue;
+          ForEachTarget(u, [&](uint32_t v) {
+            next[v] |= sources;
+          });
+        }
+        active = false;
+        uint8_t hop = std::min<uint32_t>(level, HopMatrix::kUnreachable - 1);
+        for (uint32_t v = 0; v < n; v++) {
+          uint64_t reached = next[v] & ~seen[v];
+          frontier[v] = reached;
+          if (reached == 0) continue;
+          active = true;
+          seen[v] |= reached;
+          while (reached) {
+            uint32_t i = __builtin_ctzll(reached);
+            reached &= reached - 1;
+            matrix.hops[size_t(first + i) * n + v] = hop;
+          }
+        }
+      }
+    }
+  };
+
+  if (threads <= 1) {
+    run_batches();
+    return matrix;
+  }
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back(run_batches);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return matrix;
+}
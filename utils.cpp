@@ -1,3 +1,13 @@
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "utils.h"
 
 double Distance(Coord first, Coord second) {
@@ -10,4 +20,128 @@ double Distance(Coord first, Coord second) {
 
 double deg2rad(double deg) {
     return deg * 3.1415926535897932 / 180.0;
-}
\ No newline at end of file
+}
+
+namespace {
+
+const char kCodeDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+const uint16_t kInvalidCode = UINT16_MAX;
+
+// Base 36 digit of each character, or -1 for characters that cannot appear in an airport code
+struct CodeDigitTable {
+    int8_t digit[256];
+    CodeDigitTable() {
+        memset(digit, -1, sizeof(digit));
+        for (int i = 0; i < 36; i++) {
+            digit[static_cast<unsigned char>(kCodeDigits[i])] = i;
+        }
+    }
+};
+const CodeDigitTable kCodeDigitTable;
+
+}  // namespace
+
+PackedCode::PackedCode() : value(kInvalidCode) {}
+
+/**
+* Packs an airport code into a table index
+* @param code the code to pack
+*/
+PackedCode::PackedCode(std::string_view code) : value(kInvalidCode) {
+    if (code.size() != 3) return;
+    int first = kCodeDigitTable.digit[static_cast<unsigned char>(code[0])];
+    int second = kCodeDigitTable.digit[static_cast<unsigned char>(code[1])];
+    int third = kCodeDigitTable.digit[static_cast<unsigned char>(code[2])];
+    if ((first | second | third) < 0) return;
+    value = (first * 36 + second) * 36 + third;
+}
+
+bool PackedCode::IsValid() const {
+    return value != kInvalidCode;
+}
+
+uint16_t PackedCode::Value() const {
+    return value;
+}
+
+std::string PackedCode::ToString() const {
+    if (!IsValid()) return "";
+    return {kCodeDigits[value / 1296], kCodeDigits[value / 36 % 36], kCodeDigits[value % 36]};
+}
+
+/**
+* Maps a file into memory, falling back to reading it into a buffer
+* @param path the file to open
+*/
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0), mapped(false) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            // The whole file is scanned front to back exactly once
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(addr);
+            size = st.st_size;
+            mapped = true;
+        }
+    }
+    close(fd);
+    if (mapped) return;
+    // Empty files, pipes and filesystems without mmap support
+    std::ifstream stream(path, std::ios::binary);
+    std::stringstream ss;
+    ss << stream.rdbuf();
+    buffer = ss.str();
+    data = buffer.data();
+    size = buffer.size();
+}
+
+MappedFile::~MappedFile() {
+    if (mapped) munmap(const_cast<char*>(data), size);
+}
+
+std::string_view MappedFile::Contents() const {
+    return std::string_view(data, size);
+}
+
+bool NextLine(std::string_view& buffer, std::string_view& line) {
+    if (buffer.empty()) return false;
+    size_t end = buffer.find('\n');
+    if (end == std::string_view::npos) {
+        line = buffer;
+        buffer = std::string_view();
+    } else {
+        line = buffer.substr(0, end);
+        buffer.remove_prefix(end + 1);
+    }
+    return true;
+}
+
+size_t SplitFields(std::string_view line, std::string_view* fields, size_t max_fields) {
+    size_t count = 0;
+    size_t start = 0;
+    while (count < max_fields) {
+        size_t end = line.find(',', start);
+        if (end == std::string_view::npos) {
+            fields[count++] = line.substr(start);
+            break;
+        }
+        fields[count++] = line.substr(start, end - start);
+        start = end + 1;
+    }
+    return count;
+}
+
+bool ParseDouble(std::string_view field, double& out) {
+    // strtod needs a terminated string, and fields inside a mapped file are not
+    char buf[64];
+    size_t len = field.size() < sizeof(buf) - 1 ? field.size() : sizeof(buf) - 1;
+    memcpy(buf, field.data(), len);
+    buf[len] = '\0';
+    char* end;
+    errno = 0;
+    out = strtod(buf, &end);
+    return end != buf && errno != ERANGE;
+}
@@ -2,9 +2,85 @@
 
 #include <utility>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
 
 // Latitude, Longitude
 typedef std::pair<double, double> Coord;
 
 double Distance(Coord first, Coord second);
-double deg2rad(double deg);
\ No newline at end of file
+double deg2rad(double deg);
+
+// Airport code of exactly 3 uppercase letters or digits, packed into 16 bits (base 36) so it can index a table of
+// kNumCodes entries directly instead of being hashed
+class PackedCode {
+  public:
+    static constexpr uint32_t kNumCodes = 36 * 36 * 36;
+    // Constructs an invalid code
+    PackedCode();
+    // Packs a code, the result is invalid if code is not 3 uppercase letters or digits
+    explicit PackedCode(std::string_view code);
+    bool IsValid() const;
+    // Table index in [0, kNumCodes) of a valid code
+    uint16_t Value() const;
+    std::string ToString() const;
+  private:
+    uint16_t value;
+};
+
+// Non-owning view of a contiguous array (std::span is not available before C++20)
+template <typename T>
+class Span {
+  public:
+    Span() : first(nullptr), count(0) {}
+    Span(T* first, size_t count) : first(first), count(count) {}
+    T* begin() const {
+      return first;
+    }
+    T* end() const {
+      return first + count;
+    }
+    T* data() const {
+      return first;
+    }
+    size_t size() const {
+      return count;
+    }
+    bool empty() const {
+      return count == 0;
+    }
+    T& operator[](size_t i) const {
+      return first[i];
+    }
+  private:
+    T* first;
+    size_t count;
+};
+
+// Read-only view of a whole file. The file is memory-mapped when possible so that parsers can scan it in place
+// without copying it into std::strings. A missing or unreadable file is treated as empty.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    std::string_view Contents() const;
+  private:
+    const char* data;
+    size_t size;
+    bool mapped;
+    // Used instead of the mapping when mmap is unavailable for the file
+    std::string buffer;
+};
+
+// Removes the first line from buffer and stores it (without the newline) in line
+// Returns false once buffer is exhausted
+bool NextLine(std::string_view& buffer, std::string_view& line);
+// Splits one csv line on commas, storing at most max_fields fields. Fields point into line, nothing is copied.
+// Returns the number of fields stored; scanning stops once max_fields have been found
+size_t SplitFields(std::string_view line, std::string_view* fields, size_t max_fields);
+// Parses a floating point field with the same rules as std::stod, returns false instead of throwing
+bool ParseDouble(std::string_view field, double& out);
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "varint_lists.h"
+
+namespace {
+
+size_t VarintSize(uint32_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+}  // namespace
+
+/**
+* Creates empty lists that allocate from an arena
+* @param allocator allocator for the encoded lists
+*/
+VarintLists::VarintLists(const ArenaAllocator<uint8_t>& allocator) : bytes(allocator), starts(allocator) {}
+
+/**
+* Encodes lists of ids
+* @param offsets list i is values[offsets[i]] to values[offsets[i + 1] - 1]
+* @param num_lists number of lists
+* @param values the ids of every list, sorted in place. Ids must not repeat within a list
+*/
+void VarintLists::Assign(const uint32_t* offsets, uint32_t num_lists, uint32_t* values) {
+  // The encoded size is computed first so the buffer is allocated once at its exact size
+  size_t size = 0;
+  for (uint32_t i = 0; i < num_lists; i++) {
+    std::sort(values + offsets[i], values + offsets[i + 1]);
+    uint32_t previous = 0;
+    for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) {
+      size += VarintSize(values[j] - previous);
+      previous = values[j];
+    }
+  }
+  if (size > UINT32_MAX) {
+    throw std::length_error("Compressed adjacency lists exceed 4 GB");
+  }
+  if (bytes.size() != size) {
+    // Lists encoded again after a renumbering usually change size, so the buffer is replaced rather than resized
+    bytes = ArenaVector<uint8_t>(size, bytes.get_allocator());
+  }
+  starts.resize(num_lists);
+  uint8_t* p = bytes.data();
+  for (uint32_t i = 0; i < num_lists; i++) {
+    starts[i] = p - bytes.data();
+    uint32_t previous = 0;
+    for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) {
+      uint32_t gap = values[j] - previous;
+      previous = values[j];
+      while (gap >= 0x80) {
+        *p++ = uint8_t(gap) | 0x80;
+        gap >>= 7;
+      }
+      *p++ = uint8_t(gap);
+    }
+  }
+}
+
+size_t VarintLists::MemoryUsage() const {
+  return bytes.capacity() + starts.capacity() * sizeof(uint32_t);
+}
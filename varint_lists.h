@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "arena.h"
+
+// Calls a neighbor callback. Callbacks return void, or bool where true stops the iteration early
+// Returns whether the iteration should stop
+template <typename F>
+bool CallVisitor(F& f, uint32_t id) {
+  if constexpr (std::is_void_v<decltype(f(id))>) {
+    f(id);
+    return false;
+  } else {
+    return f(id);
+  }
+}
+
+// Lists of vertex ids stored sorted, as the gaps between consecutive ids encoded as varints: 7 bits per byte, lowest
+// bits first, with the high bit set on every byte of a value but the last. The first id of a list is its gap from 0
+// Neighbors with nearby ids (see VertexOrder) take 1 byte per id instead of 4
+class VarintLists {
+  public:
+    VarintLists() = default;
+    explicit VarintLists(const ArenaAllocator<uint8_t>& allocator);
+    // Sorts each list values[offsets[i]..offsets[i + 1]) in place and encodes it as list i, replacing every list
+    // Throws std::length_error if the encoded lists take more than 4 GB
+    void Assign(const uint32_t* offsets, uint32_t num_lists, uint32_t* values);
+    // Calls f(id) for every id of a list in increasing order, decoding as it goes. count is the length of the list
+    // Returns true if f stopped the iteration (see CallVisitor)
+    template <typename F>
+    bool ForEach(uint32_t list, uint32_t count, F f) const;
+    // Bytes allocated by the lists
+    size_t MemoryUsage() const;
+  private:
+    // Encoded lists back to back
+    ArenaVector<uint8_t> bytes;
+    // Position of each list in bytes
+    ArenaVector<uint32_t> starts;
+};
+
+template <typename F>
+bool VarintLists::ForEach(uint32_t list, uint32_t count, F f) const {
+  const uint8_t* p = bytes.data() + starts[list];
+  uint32_t id = 0;
+  while (count > 0) {
+    // Eight gaps that each fit in one byte are detected with a single test over a word and decoded without branches.
+    // Every id takes at least one byte, so the word never extends past the end of the list
+    if (count >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      if ((word & 0x8080808080808080ull) == 0) {
+        for (int i = 0; i < 8; i++) {
+          id += p[i];
+          if (CallVisitor(f, id)) return true;
+        }
+        p += 8;
+        count -= 8;
+        continue;
+      }
+    }
+    uint32_t gap = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+      gap |= uint32_t(*p++ & 0x7f) << shift;
+      shift += 7;
+    }
+    gap |= uint32_t(*p++) << shift;
+    id += gap;
+    if (CallVisitor(f, id)) return true;
+    count--;
+  }
+  return false;
+}